@@ -0,0 +1,26 @@
+#include "AttributePool.h"
+
+AttributePool::AttributePool()
+{
+    this->firstId = 1;
+}
+
+void AttributePool::reset(int firstId)
+{
+    this->firstId = firstId;
+    colors.clear();
+}
+
+/*
+ * Store c and return its color id.
+ */
+int AttributePool::addColor(const Color &c)
+{
+    colors.push_back(c);
+    return firstId + colors.size() - 1;
+}
+
+const Color &AttributePool::getColor(int colorId) const
+{
+    return colors[colorId - firstId];
+}
@@ -0,0 +1,27 @@
+#ifndef __ATTRIBUTEPOOL_H__
+#define __ATTRIBUTEPOOL_H__
+
+#include <vector>
+#include "Color.h"
+
+using namespace std;
+
+/*
+ * Scratch storage for vertex colors generated by clipping during one frame.
+ * Ids continue after the scene's own vertex colors. reset() forgets the
+ * colors but keeps the memory, so repeated frames stop allocating.
+ */
+class AttributePool
+{
+public:
+    vector<Color> colors;
+    int firstId; // color id of colors[0]
+
+    AttributePool();
+
+    void reset(int firstId);
+    int addColor(const Color &c);
+    const Color &getColor(int colorId) const;
+};
+
+#endif
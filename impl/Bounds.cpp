@@ -0,0 +1,170 @@
+#include "Bounds.h"
+#include <cmath>
+
+// relative margin, vertices on the surface of the box must classify like the box
+#define BOUNDS_EPSILON 1e-9
+
+Bounds::Bounds()
+{
+    for (int i = 0; i < 3; i++)
+    {
+        min[i] = max[i] = center[i] = 0;
+    }
+    radius = -1;
+}
+
+/*
+ * Box of the vertices listed in ids, and the sphere around its center that
+ * holds every one of them.
+ */
+void Bounds::compute(const VertexBuffer &vertices, Span<const uint32_t> ids)
+{
+    radius = -1;
+    if (ids.size() == 0)
+    {
+        return;
+    }
+
+    const double *p[3] = {vertices.x.data, vertices.y.data, vertices.z.data};
+    for (int i = 0; i < 3; i++)
+    {
+        min[i] = max[i] = p[i][ids[0]];
+    }
+    for (uint32_t id : ids)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            min[i] = fmin(min[i], p[i][id]);
+            max[i] = fmax(max[i], p[i][id]);
+        }
+    }
+
+    double radiusSquared = 0;
+    for (int i = 0; i < 3; i++)
+    {
+        center[i] = (min[i] + max[i]) / 2;
+    }
+    for (uint32_t id : ids)
+    {
+        double dx = p[0][id] - center[0], dy = p[1][id] - center[1], dz = p[2][id] - center[2];
+        radiusSquared = fmax(radiusSquared, dx * dx + dy * dy + dz * dz);
+    }
+    radius = sqrt(radiusSquared);
+}
+
+bool Bounds::project(const Matrix4 &modelToScreen, double &minX, double &minY, double &maxX, double &maxY, double &minZ) const
+{
+    if (isEmpty())
+    {
+        return false;
+    }
+
+    const double (*m)[4] = modelToScreen.val;
+    minX = minY = minZ = HUGE_VAL;
+    maxX = maxY = -HUGE_VAL;
+
+    for (int corner = 0; corner < 8; corner++)
+    {
+        double p[3] = {corner & 1 ? max[0] : min[0], corner & 2 ? max[1] : min[1], corner & 4 ? max[2] : min[2]};
+        double v[4];
+        for (int r = 0; r < 4; r++)
+        {
+            v[r] = m[r][0] * p[0] + m[r][1] * p[1] + m[r][2] * p[2] + m[r][3];
+        }
+        if (!(v[3] > 0))
+        {
+            return false;
+        }
+
+        double x = v[0] / v[3], y = v[1] / v[3], z = v[2] / v[3];
+        minX = fmin(minX, x);
+        maxX = fmax(maxX, x);
+        minY = fmin(minY, y);
+        maxY = fmax(maxY, y);
+        minZ = fmin(minZ, z);
+    }
+    return true;
+}
+
+bool Bounds::isEmpty() const
+{
+    return radius < 0;
+}
+
+/*
+ * Margin below which a distance to plane is treated as touching it.
+ */
+static double planeMargin(const double plane[4], double normal, const double center[3], double reach)
+{
+    return BOUNDS_EPSILON * (normal * (fabs(center[0]) + fabs(center[1]) + fabs(center[2]) + reach) + fabs(plane[3]));
+}
+
+int Bounds::classify(const double planes[6][4]) const
+{
+    if (isEmpty())
+    {
+        return BOUNDS_OUTSIDE;
+    }
+
+    // sphere first, the box only for the planes it crosses
+    int crossed = 0;
+    for (int p = 0; p < 6; p++)
+    {
+        const double *plane = planes[p];
+        double distance = plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3];
+        double normal = sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        double margin = planeMargin(plane, normal, center, radius);
+        double reach = normal * radius;
+
+        if (distance + reach < -margin)
+        {
+            return BOUNDS_OUTSIDE;
+        }
+        if (distance - reach <= margin)
+        {
+            crossed |= 1 << p;
+        }
+    }
+
+    if (crossed == 0)
+    {
+        return BOUNDS_INSIDE;
+    }
+    return classifyBox(min, max, planes, crossed);
+}
+
+int Bounds::classifyBox(const double min[3], const double max[3], const double planes[6][4], int &planeMask)
+{
+    double center[3], extent[3];
+    for (int i = 0; i < 3; i++)
+    {
+        center[i] = (min[i] + max[i]) / 2;
+        extent[i] = max[i] - center[i];
+    }
+
+    for (int p = 0; p < 6; p++)
+    {
+        if (!(planeMask & (1 << p)))
+        {
+            continue;
+        }
+
+        const double *plane = planes[p];
+        double distance = plane[0] * center[0] + plane[1] * center[1] + plane[2] * center[2] + plane[3];
+        double normal = sqrt(plane[0] * plane[0] + plane[1] * plane[1] + plane[2] * plane[2]);
+        double margin = planeMargin(plane, normal, center, extent[0] + extent[1] + extent[2]);
+
+        // the corner furthest along the plane normal and the one furthest against it
+        double reach = fabs(plane[0]) * extent[0] + fabs(plane[1]) * extent[1] + fabs(plane[2]) * extent[2];
+        if (distance + reach < -margin)
+        {
+            return BOUNDS_OUTSIDE;
+        }
+        if (distance - reach > margin)
+        {
+            planeMask &= ~(1 << p);
+        }
+    }
+
+    return planeMask == 0 ? BOUNDS_INSIDE : BOUNDS_INTERSECTING;
+}
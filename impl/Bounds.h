@@ -0,0 +1,54 @@
+#ifndef __BOUNDS_H__
+#define __BOUNDS_H__
+
+#include <cstdint>
+#include "Matrix4.h"
+#include "Span.h"
+#include "VertexBuffer.h"
+
+using namespace std;
+
+#define BOUNDS_OUTSIDE 0      // entirely outside one of the planes
+#define BOUNDS_INTERSECTING 1 // may cross a plane, needs per-triangle work
+#define BOUNDS_INSIDE 2       // inside every plane, no clipping needed
+
+/*
+ * Axis aligned box and bounding sphere of a set of vertices, in the space
+ * the vertices are given in.
+ */
+class Bounds
+{
+public:
+    double min[3], max[3];
+    double center[3]; // center of the box, also the center of the sphere
+    double radius;    // sphere radius, < 0 when the bounds are empty
+
+    Bounds();
+
+    void compute(const VertexBuffer &vertices, Span<const uint32_t> ids);
+    bool isEmpty() const;
+
+    /*
+     * Tests the volume against planes in the same space. Plane p keeps point v
+     * when planes[p] . (v, 1) >= 0, like the clip planes. The sphere answers
+     * most meshes, the box is only tested when the sphere crosses a plane.
+     */
+    int classify(const double planes[6][4]) const;
+
+    /*
+     * Projects the box through modelToScreen, a matrix into homogeneous viewport
+     * space, and gives the screen rectangle and nearest depth of its corners
+     * after the perspective divide. Returns false when a corner is not in front
+     * of the eye, as the box then has no finite projection.
+     */
+    bool project(const Matrix4 &modelToScreen, double &minX, double &minY, double &maxX, double &maxY, double &minZ) const;
+
+    /*
+     * Box test against the planes whose bits are set in planeMask. Bits of
+     * planes the box is entirely inside of are cleared, so children of the
+     * box can skip them.
+     */
+    static int classifyBox(const double min[3], const double max[3], const double planes[6][4], int &planeMask);
+};
+
+#endif
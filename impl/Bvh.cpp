@@ -0,0 +1,406 @@
+#include "Bvh.h"
+#include "Bounds.h"
+#include <algorithm>
+#include <cmath>
+
+static_assert(sizeof(BvhNode) == 64, "bvh nodes are one cache line");
+
+Bvh::Bvh()
+{
+}
+
+bool Bvh::isEmpty() const
+{
+    return nodes.size() == 0;
+}
+
+void Bvh::useExternal(Span<const BvhNode> nodes, Span<const uint32_t> order)
+{
+    storedNodes.clear();
+    storedOrder.clear();
+    this->nodes = nodes;
+    this->order = order;
+}
+
+void Bvh::classify(const double planes[6][4], uint8_t *visibility) const
+{
+    if (isEmpty())
+    {
+        return;
+    }
+
+    // node and the planes it still has to be tested against
+    uint32_t stack[64][2];
+    int top = 0;
+    stack[top][0] = 0;
+    stack[top][1] = 0x3F;
+    top++;
+
+    while (top > 0)
+    {
+        top--;
+        const BvhNode &node = nodes[stack[top][0]];
+        int planeMask = stack[top][1];
+
+        int result = Bounds::classifyBox(node.min, node.max, planes, planeMask);
+        if (result == BOUNDS_OUTSIDE)
+        {
+            continue;
+        }
+
+        if (result == BOUNDS_INSIDE || node.left == 0 || top + 2 > 64)
+        {
+            for (uint32_t i = node.first; i < node.first + node.count; i++)
+            {
+                visibility[order[i]] = result;
+            }
+            continue;
+        }
+
+        stack[top][0] = node.left + 1;
+        stack[top][1] = planeMask;
+        top++;
+        stack[top][0] = node.left;
+        stack[top][1] = planeMask;
+        top++;
+    }
+}
+
+bool Bvh::isValid(size_t triangleCount) const
+{
+    if (isEmpty())
+    {
+        return true;
+    }
+    if (order.size() != triangleCount || nodes[0].first != 0 || nodes[0].count != triangleCount)
+    {
+        return false;
+    }
+    for (uint32_t t : order)
+    {
+        if (t >= triangleCount)
+        {
+            return false;
+        }
+    }
+    for (size_t i = 0; i < nodes.size(); i++)
+    {
+        const BvhNode &node = nodes[i];
+        if (node.first > triangleCount || node.count > triangleCount - node.first)
+        {
+            return false;
+        }
+        // children come after their parent, so following them always ends
+        if (node.left != 0 && (node.left <= i || node.left + 1 >= nodes.size()))
+        {
+            return false;
+        }
+    }
+    return true;
+}
+
+BvhBuilder::BvhBuilder()
+{
+}
+
+static double surfaceArea(const double lo[3], const double hi[3])
+{
+    double dx = hi[0] - lo[0], dy = hi[1] - lo[1], dz = hi[2] - lo[2];
+    return 2 * (dx * dy + dy * dz + dz * dx);
+}
+
+static void growBox(double lo[3], double hi[3], const double *pointLo, const double *pointHi)
+{
+    for (int i = 0; i < 3; i++)
+    {
+        lo[i] = min(lo[i], pointLo[i]);
+        hi[i] = max(hi[i], pointHi[i]);
+    }
+}
+
+static void emptyBox(double lo[3], double hi[3])
+{
+    for (int i = 0; i < 3; i++)
+    {
+        lo[i] = HUGE_VAL;
+        hi[i] = -HUGE_VAL;
+    }
+}
+
+/*
+ * Computes the per-triangle boxes and the top of the tree.
+ */
+void BvhBuilder::start(const VertexBuffer &vertices, Span<const uint32_t> indices)
+{
+    uint32_t triangles = indices.size() / 3;
+    const double *p[3] = {vertices.x.data, vertices.y.data, vertices.z.data};
+
+    triangleMin.resize(3 * triangles);
+    triangleMax.resize(3 * triangles);
+    centroid.resize(3 * triangles);
+    order.resize(triangles);
+    for (uint32_t t = 0; t < triangles; t++)
+    {
+        for (int i = 0; i < 3; i++)
+        {
+            double a = p[i][indices[3 * t]], b = p[i][indices[3 * t + 1]], c = p[i][indices[3 * t + 2]];
+            triangleMin[3 * t + i] = min(min(a, b), c);
+            triangleMax[3 * t + i] = max(max(a, b), c);
+            centroid[3 * t + i] = (triangleMin[3 * t + i] + triangleMax[3 * t + i]) / 2;
+        }
+        order[t] = t;
+    }
+
+    nodes.clear();
+    taskNodes.clear();
+    if (triangles == 0)
+    {
+        return;
+    }
+
+    BvhNode root;
+    root.first = 0;
+    root.count = triangles;
+    root.left = 0;
+    root.reserved = 0;
+    setBounds(root);
+    nodes.push_back(root);
+    subdivide(nodes, 0, BVH_PARALLEL_DEPTH);
+
+    taskTrees.assign(taskNodes.size(), vector<BvhNode>());
+}
+
+int BvhBuilder::taskCount() const
+{
+    return taskNodes.size();
+}
+
+/*
+ * Builds the subtree under one of the task nodes. Tasks work on disjoint
+ * ranges of order, so they can run at the same time.
+ */
+void BvhBuilder::runTask(int task)
+{
+    vector<BvhNode> &tree = taskTrees[task];
+    tree.assign(1, nodes[taskNodes[task]]);
+    subdivide(tree, 0, -1);
+}
+
+/*
+ * Appends the task subtrees behind the top nodes and moves the result into bvh.
+ */
+void BvhBuilder::finish(Bvh &bvh)
+{
+    for (int task = 0; task < taskCount(); task++)
+    {
+        const vector<BvhNode> &tree = taskTrees[task];
+
+        // tree[0] replaces the task node, tree[i] lands at base + i - 1
+        uint32_t base = nodes.size();
+        for (size_t i = 0; i < tree.size(); i++)
+        {
+            BvhNode node = tree[i];
+            if (node.left != 0)
+            {
+                node.left = base + node.left - 1;
+            }
+            if (i == 0)
+            {
+                nodes[taskNodes[task]] = node;
+            }
+            else
+            {
+                nodes.push_back(node);
+            }
+        }
+    }
+
+    bvh.storedNodes.swap(nodes);
+    bvh.storedOrder.swap(order);
+    bvh.nodes = Span<const BvhNode>(bvh.storedNodes);
+    bvh.order = Span<const uint32_t>(bvh.storedOrder);
+
+    nodes.clear();
+    order.clear();
+    taskNodes.clear();
+    taskTrees.clear();
+    triangleMin.clear();
+    triangleMax.clear();
+    centroid.clear();
+}
+
+void BvhBuilder::setBounds(BvhNode &node) const
+{
+    emptyBox(node.min, node.max);
+    for (uint32_t i = node.first; i < node.first + node.count; i++)
+    {
+        growBox(node.min, node.max, &triangleMin[3 * order[i]], &triangleMax[3 * order[i]]);
+    }
+}
+
+/*
+ * Splits tree[node] until the leaves are cheaper than splitting them.
+ * Below serialDepth levels the children are left to tasks instead,
+ * a negative serialDepth builds the whole subtree.
+ */
+void BvhBuilder::subdivide(vector<BvhNode> &tree, uint32_t node, int serialDepth)
+{
+    if (serialDepth == 0)
+    {
+        taskNodes.push_back(node);
+        return;
+    }
+
+    BvhNode left, right;
+    if (!split(tree[node], left, right))
+    {
+        return;
+    }
+
+    // tree may grow while the children are built, so nodes are referred to by index
+    uint32_t leftIndex = tree.size();
+    tree[node].left = leftIndex;
+    tree.push_back(left);
+    tree.push_back(right);
+
+    subdivide(tree, leftIndex, serialDepth - 1);
+    subdivide(tree, leftIndex + 1, serialDepth - 1);
+}
+
+/*
+ * Picks the binned SAH split of node, partitions its range of order around
+ * it and fills in the two children. Returns false when node should stay a leaf.
+ */
+bool BvhBuilder::split(const BvhNode &node, BvhNode &left, BvhNode &right)
+{
+    if (node.count <= BVH_LEAF_TRIANGLES)
+    {
+        return false;
+    }
+
+    uint32_t begin = node.first, end = node.first + node.count;
+    double centroidMin[3], centroidMax[3];
+    emptyBox(centroidMin, centroidMax);
+    for (uint32_t i = begin; i < end; i++)
+    {
+        growBox(centroidMin, centroidMax, &centroid[3 * order[i]], &centroid[3 * order[i]]);
+    }
+
+    // bin every triangle on all three axes in one pass
+    uint32_t binCount[3][BVH_BINS] = {{0}};
+    double binMin[3][BVH_BINS][3], binMax[3][BVH_BINS][3];
+    double scale[3];
+    for (int axis = 0; axis < 3; axis++)
+    {
+        double extent = centroidMax[axis] - centroidMin[axis];
+        scale[axis] = extent > 0 ? BVH_BINS / extent : 0;
+        for (int b = 0; b < BVH_BINS; b++)
+        {
+            emptyBox(binMin[axis][b], binMax[axis][b]);
+        }
+    }
+    for (uint32_t i = begin; i < end; i++)
+    {
+        uint32_t t = order[i];
+        for (int axis = 0; axis < 3; axis++)
+        {
+            int b = min(BVH_BINS - 1, (int)((centroid[3 * t + axis] - centroidMin[axis]) * scale[axis]));
+            binCount[axis][b]++;
+            growBox(binMin[axis][b], binMax[axis][b], &triangleMin[3 * t], &triangleMax[3 * t]);
+        }
+    }
+
+    double bestCost = HUGE_VAL;
+    int bestAxis = -1, bestBin = 0;
+    for (int axis = 0; axis < 3; axis++)
+    {
+        if (scale[axis] == 0)
+        {
+            continue;
+        }
+
+        // boxes of everything right of each bin boundary, then sweep from the left
+        double rightMin[BVH_BINS][3], rightMax[BVH_BINS][3];
+        uint32_t rightCount[BVH_BINS];
+        double boxMin[3], boxMax[3];
+        emptyBox(boxMin, boxMax);
+        uint32_t count = 0;
+        for (int b = BVH_BINS - 1; b > 0; b--)
+        {
+            growBox(boxMin, boxMax, binMin[axis][b], binMax[axis][b]);
+            count += binCount[axis][b];
+            for (int i = 0; i < 3; i++)
+            {
+                rightMin[b][i] = boxMin[i];
+                rightMax[b][i] = boxMax[i];
+            }
+            rightCount[b] = count;
+        }
+
+        emptyBox(boxMin, boxMax);
+        count = 0;
+        for (int b = 0; b < BVH_BINS - 1; b++)
+        {
+            growBox(boxMin, boxMax, binMin[axis][b], binMax[axis][b]);
+            count += binCount[axis][b];
+            if (count == 0 || rightCount[b + 1] == 0)
+            {
+                continue;
+            }
+            double cost = count * surfaceArea(boxMin, boxMax) + rightCount[b + 1] * surfaceArea(rightMin[b + 1], rightMax[b + 1]);
+            if (cost < bestCost)
+            {
+                bestCost = cost;
+                bestAxis = axis;
+                bestBin = b;
+                for (int i = 0; i < 3; i++)
+                {
+                    left.min[i] = boxMin[i];
+                    left.max[i] = boxMax[i];
+                    right.min[i] = rightMin[b + 1][i];
+                    right.max[i] = rightMax[b + 1][i];
+                }
+            }
+        }
+    }
+
+    uint32_t middle;
+    if (bestAxis < 0)
+    {
+        // every centroid is in the same place, only the size limit splits these
+        if (node.count <= BVH_MAX_LEAF_TRIANGLES)
+        {
+            return false;
+        }
+        middle = begin + node.count / 2;
+    }
+    else
+    {
+        double area = surfaceArea(node.min, node.max);
+        double splitCost = BVH_TRAVERSAL_COST + (area > 0 ? bestCost / area : 0);
+        if (splitCost >= node.count && node.count <= BVH_MAX_LEAF_TRIANGLES)
+        {
+            return false;
+        }
+
+        const vector<double> &centroids = centroid;
+        double lowest = centroidMin[bestAxis], axisScale = scale[bestAxis];
+        uint32_t *split = partition(order.data() + begin, order.data() + end, [&](uint32_t t) {
+            return min(BVH_BINS - 1, (int)((centroids[3 * t + bestAxis] - lowest) * axisScale)) <= bestBin;
+        });
+        middle = split - order.data();
+    }
+
+    left.first = begin;
+    left.count = middle - begin;
+    right.first = middle;
+    right.count = end - middle;
+    left.left = right.left = 0;
+    left.reserved = right.reserved = 0;
+    if (bestAxis < 0)
+    {
+        setBounds(left);
+        setBounds(right);
+    }
+    return left.count > 0 && right.count > 0;
+}
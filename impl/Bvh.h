@@ -0,0 +1,98 @@
+#ifndef __BVH_H__
+#define __BVH_H__
+
+#include <cstdint>
+#include <vector>
+#include "Span.h"
+#include "VertexBuffer.h"
+
+using namespace std;
+
+#define BVH_MIN_TRIANGLES 256       // smaller meshes are only tested as a whole
+#define BVH_LEAF_TRIANGLES 8        // nodes this small are never split
+#define BVH_MAX_LEAF_TRIANGLES 32   // nodes larger than this are always split
+#define BVH_BINS 12                 // centroid bins per axis for the SAH
+#define BVH_TRAVERSAL_COST 1.0      // cost of visiting a node, in triangle tests
+#define BVH_PARALLEL_DEPTH 2        // levels built serially before subtrees go to the pool
+
+/*
+ * Node of a flattened BVH, one cache line. The triangles under a node are
+ * order[first] .. order[first + count - 1] of its Bvh; children are stored
+ * next to each other at left and left + 1.
+ */
+class BvhNode
+{
+public:
+    double min[3], max[3];
+    uint32_t first, count;
+    uint32_t left; // 0 for leaves, the root is never a child
+    uint32_t reserved;
+};
+
+/*
+ * Bounding volume hierarchy over the triangles of one mesh, in object space.
+ * Like the mesh arrays, nodes and order are views of storage built here
+ * or of a mapped scene cache.
+ */
+class Bvh
+{
+public:
+    Span<const BvhNode> nodes; // nodes[0] is the root
+    Span<const uint32_t> order; // triangle numbers of the mesh, in leaf order
+
+    Bvh();
+
+    bool isEmpty() const;
+    void useExternal(Span<const BvhNode> nodes, Span<const uint32_t> order);
+
+    /*
+     * Writes BOUNDS_INSIDE or BOUNDS_INTERSECTING to visibility[t] for every
+     * triangle t under a node that is not outside the planes. Entries of
+     * triangles under outside nodes are left untouched.
+     */
+    void classify(const double planes[6][4], uint8_t *visibility) const;
+
+    /*
+     * Checks that the views form a tree over triangleCount triangles,
+     * for hierarchies read from a file.
+     */
+    bool isValid(size_t triangleCount) const;
+
+private:
+    vector<BvhNode> storedNodes;
+    vector<uint32_t> storedOrder;
+
+    Bvh(const Bvh &other);
+    Bvh &operator=(const Bvh &other);
+
+    friend class BvhBuilder;
+};
+
+/*
+ * SAH build of one Bvh. start() builds the top BVH_PARALLEL_DEPTH levels and
+ * leaves the subtrees below them as tasks, which may run on different
+ * threads, even for different builders. finish() joins them into the Bvh.
+ */
+class BvhBuilder
+{
+public:
+    BvhBuilder();
+
+    void start(const VertexBuffer &vertices, Span<const uint32_t> indices);
+    int taskCount() const;
+    void runTask(int task);
+    void finish(Bvh &bvh);
+
+private:
+    vector<double> triangleMin, triangleMax, centroid; // 3 per triangle
+    vector<uint32_t> order;
+    vector<BvhNode> nodes;
+    vector<uint32_t> taskNodes; // nodes whose subtrees are built by the tasks
+    vector< vector<BvhNode> > taskTrees;
+
+    void setBounds(BvhNode &node) const;
+    void subdivide(vector<BvhNode> &tree, uint32_t node, int serialDepth);
+    bool split(const BvhNode &node, BvhNode &left, BvhNode &right);
+};
+
+#endif
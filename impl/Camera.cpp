@@ -88,7 +88,7 @@ Matrix4 Camera::computeCVVMatrix(){
     return M;
 }
 
-Matrix4 Camera::getMatrix(){
+const Matrix4 &Camera::getMatrix(){
     if(initializedMatrix){
         return matrix;
     }
@@ -41,7 +41,7 @@ public:
 
     Camera(const Camera &other);
 
-    Matrix4 getMatrix();
+    const Matrix4 &getMatrix();
     Matrix4 computeCameraMatrix();
     Matrix4 computeCVVMatrix();
 
@@ -0,0 +1,9 @@
+#include "ClipVertex.h"
+
+ClipVertex::ClipVertex() {}
+
+ClipVertex::ClipVertex(const Vec4 &position, const Color &color)
+{
+    this->position = position;
+    this->color = color;
+}
@@ -0,0 +1,23 @@
+#ifndef __CLIPVERTEX_H__
+#define __CLIPVERTEX_H__
+
+#include "Vec4.h"
+#include "Color.h"
+
+// a clipped triangle has at most 9 corners, one extra slot is scratch for the clipper
+#define MAX_CLIP_VERTICES 10
+
+/*
+ * Vertex as it moves through clipping and rasterization, with its color carried inline.
+ */
+class ClipVertex
+{
+public:
+    Vec4 position;
+    Color color;
+
+    ClipVertex();
+    ClipVertex(const Vec4 &position, const Color &color);
+};
+
+#endif
@@ -0,0 +1,72 @@
+#include "DepthBuffer.h"
+#include <limits>
+#include <algorithm>
+
+using namespace std;
+
+DepthBuffer::DepthBuffer()
+{
+    this->width = 0;
+    this->height = 0;
+    this->tilesX = 0;
+    this->tilesY = 0;
+}
+
+/*
+ * Size the buffer for a width x height image and reset it to "infinitely far".
+ */
+void DepthBuffer::initialize(int width, int height)
+{
+    if (this->width != width || this->height != height)
+    {
+        this->width = width;
+        this->height = height;
+        this->tilesX = (width + DEPTH_TILE_SIZE - 1) / DEPTH_TILE_SIZE;
+        this->tilesY = (height + DEPTH_TILE_SIZE - 1) / DEPTH_TILE_SIZE;
+
+        depth.resize(width * height);
+        tileMin.resize(tilesX * tilesY);
+        tileMax.resize(tilesX * tilesY);
+    }
+
+    clear();
+}
+
+void DepthBuffer::clear()
+{
+    double far = numeric_limits<double>::infinity();
+
+    fill(depth.begin(), depth.end(), far);
+    fill(tileMin.begin(), tileMin.end(), far);
+    fill(tileMax.begin(), tileMax.end(), far);
+}
+
+int DepthBuffer::tileIndex(int tx, int ty)
+{
+    return tx + ty * tilesX;
+}
+
+/*
+ * Recompute the min/max depth of a tile after some of its pixels were written.
+ */
+void DepthBuffer::updateTile(int tx, int ty)
+{
+    int x0 = tx * DEPTH_TILE_SIZE, x1 = min(x0 + DEPTH_TILE_SIZE, width);
+    int y0 = ty * DEPTH_TILE_SIZE, y1 = min(y0 + DEPTH_TILE_SIZE, height);
+
+    double lo = depth[x0 + y0 * width];
+    double hi = lo;
+
+    for (int y = y0; y < y1; y++)
+    {
+        for (int x = x0; x < x1; x++)
+        {
+            double d = depth[x + y * width];
+            lo = min(lo, d);
+            hi = max(hi, d);
+        }
+    }
+
+    tileMin[tileIndex(tx, ty)] = lo;
+    tileMax[tileIndex(tx, ty)] = hi;
+}
@@ -0,0 +1,27 @@
+#ifndef __DEPTHBUFFER_H__
+#define __DEPTHBUFFER_H__
+
+#include <vector>
+
+using namespace std;
+
+#define DEPTH_TILE_SIZE 8
+
+class DepthBuffer
+{
+public:
+    int width, height;
+    int tilesX, tilesY;
+    vector<double> depth;   // per pixel depth, indexed x + y * width
+    vector<double> tileMin; // nearest depth stored in each tile
+    vector<double> tileMax; // farthest depth stored in each tile
+
+    DepthBuffer();
+
+    void initialize(int width, int height);
+    void clear();
+    int tileIndex(int tx, int ty);
+    void updateTile(int tx, int ty);
+};
+
+#endif
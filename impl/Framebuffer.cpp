@@ -0,0 +1,250 @@
+#include "Framebuffer.h"
+#include <cstdlib>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define FRAMEBUFFER_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+#define FRAMEBUFFER_ALIGNMENT 64
+
+Framebuffer::Framebuffer()
+{
+    this->width = 0;
+    this->height = 0;
+    this->format = FORMAT_RGBA8;
+    this->data = NULL;
+    this->capacity = 0;
+}
+
+Framebuffer::~Framebuffer()
+{
+    free(data);
+}
+
+/*
+ * Size the storage for a width x height image. Memory is only reallocated when it grows.
+ */
+void Framebuffer::initialize(int width, int height, int format)
+{
+    size_t pixelSize = format == FORMAT_RGBA8 ? sizeof(uint32_t) : 4 * sizeof(float);
+    size_t bytes = (size_t)width * height * pixelSize;
+    bytes = (bytes + FRAMEBUFFER_ALIGNMENT - 1) / FRAMEBUFFER_ALIGNMENT * FRAMEBUFFER_ALIGNMENT;
+
+    if (bytes > capacity)
+    {
+        free(data);
+        data = aligned_alloc(FRAMEBUFFER_ALIGNMENT, bytes);
+        capacity = bytes;
+    }
+
+    this->width = width;
+    this->height = height;
+    this->format = format;
+}
+
+/*
+ * Fill every pixel with c, 16 bytes per store.
+ */
+void Framebuffer::clear(const Color &c)
+{
+    size_t count = (size_t)width * height;
+
+    if (format == FORMAT_RGBA8)
+    {
+        uint32_t value = packRGBA8(c);
+        uint32_t *p = (uint32_t *)data;
+        size_t i = 0;
+#ifdef FRAMEBUFFER_X86
+        __m128i v = _mm_set1_epi32(value);
+        for (; i + 4 <= count; i += 4)
+        {
+            _mm_store_si128((__m128i *)(p + i), v);
+        }
+#endif
+        for (; i < count; i++)
+        {
+            p[i] = value;
+        }
+    }
+    else
+    {
+        float *p = (float *)data;
+        float r = toByte(c.r), g = toByte(c.g), b = toByte(c.b);
+        size_t i = 0;
+#ifdef FRAMEBUFFER_X86
+        __m128 v = _mm_setr_ps(r, g, b, 255.0f);
+        for (; i < count; i++)
+        {
+            _mm_store_ps(p + 4 * i, v);
+        }
+#else
+        for (; i < count; i++)
+        {
+            p[4 * i] = r;
+            p[4 * i + 1] = g;
+            p[4 * i + 2] = b;
+            p[4 * i + 3] = 255.0f;
+        }
+#endif
+    }
+}
+
+void Framebuffer::setPixel(int x, int y, const Color &c)
+{
+    if (format == FORMAT_RGBA8)
+    {
+        rgba8Row(y)[x] = packRGBA8(c);
+    }
+    else
+    {
+        // converted in double first, narrowing could round 127.99999 up to 128
+        float *p = floatRow(y) + 4 * x;
+        p[0] = toByte(c.r);
+        p[1] = toByte(c.g);
+        p[2] = toByte(c.b);
+        p[3] = 255.0f;
+    }
+}
+
+Color Framebuffer::getPixel(int x, int y) const
+{
+    if (format == FORMAT_RGBA8)
+    {
+        uint32_t p = rgba8Row(y)[x];
+        return Color(p & 0xFF, (p >> 8) & 0xFF, (p >> 16) & 0xFF);
+    }
+
+    const float *p = floatRow(y) + 4 * x;
+    return Color(p[0], p[1], p[2]);
+}
+
+uint32_t *Framebuffer::rgba8Row(int y)
+{
+    return (uint32_t *)data + (size_t)(height - 1 - y) * width;
+}
+
+float *Framebuffer::floatRow(int y)
+{
+    return (float *)data + (size_t)(height - 1 - y) * width * 4;
+}
+
+const uint32_t *Framebuffer::rgba8Row(int y) const
+{
+    return (const uint32_t *)data + (size_t)(height - 1 - y) * width;
+}
+
+const float *Framebuffer::floatRow(int y) const
+{
+    return (const float *)data + (size_t)(height - 1 - y) * width * 4;
+}
+
+#ifdef FRAMEBUFFER_X86
+
+/*
+ * Drops the alpha byte of four pixels per shuffle. Returns how many pixels it packed.
+ */
+__attribute__((target("ssse3")))
+static size_t packRGBA8ToRGBSSSE3(const uint32_t *in, uint8_t *out, size_t count)
+{
+    const __m128i dropAlpha = _mm_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+    size_t i = 0;
+
+    // each store writes 16 bytes for 12 bytes of pixels, stay clear of the end
+    for (; i + 6 <= count; i += 4)
+    {
+        __m128i p = _mm_load_si128((const __m128i *)(in + i));
+        _mm_storeu_si128((__m128i *)(out + 3 * i), _mm_shuffle_epi8(p, dropAlpha));
+    }
+
+    return i;
+}
+
+/*
+ * Clamps and truncates four float pixels at a time. Returns how many pixels it packed.
+ */
+static size_t packFloatToRGBSSE2(const float *in, uint8_t *out, size_t count)
+{
+    const __m128 lo = _mm_setzero_ps(), hi = _mm_set1_ps(255.0f);
+    uint8_t bytes[16];
+    size_t i = 0;
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128i p0 = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_load_ps(in + 4 * i), lo), hi));
+        __m128i p1 = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_load_ps(in + 4 * i + 4), lo), hi));
+        __m128i p2 = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_load_ps(in + 4 * i + 8), lo), hi));
+        __m128i p3 = _mm_cvttps_epi32(_mm_min_ps(_mm_max_ps(_mm_load_ps(in + 4 * i + 12), lo), hi));
+        _mm_storeu_si128((__m128i *)bytes, _mm_packus_epi16(_mm_packs_epi32(p0, p1), _mm_packs_epi32(p2, p3)));
+
+        for (int k = 0; k < 4; k++)
+        {
+            out[3 * (i + k)] = bytes[4 * k];
+            out[3 * (i + k) + 1] = bytes[4 * k + 1];
+            out[3 * (i + k) + 2] = bytes[4 * k + 2];
+        }
+    }
+
+    return i;
+}
+
+#endif
+
+/*
+ * Writes the image as tightly packed RGB bytes, top row first,
+ * width * height * 3 bytes in total.
+ */
+void Framebuffer::packRGB(uint8_t *out) const
+{
+    size_t count = (size_t)width * height;
+    size_t i = 0;
+
+    if (format == FORMAT_RGBA8)
+    {
+        const uint32_t *p = (const uint32_t *)data;
+#ifdef FRAMEBUFFER_X86
+        if (__builtin_cpu_supports("ssse3"))
+        {
+            i = packRGBA8ToRGBSSSE3(p, out, count);
+        }
+#endif
+        for (; i < count; i++)
+        {
+            out[3 * i] = p[i] & 0xFF;
+            out[3 * i + 1] = (p[i] >> 8) & 0xFF;
+            out[3 * i + 2] = (p[i] >> 16) & 0xFF;
+        }
+    }
+    else
+    {
+        const float *p = (const float *)data;
+#ifdef FRAMEBUFFER_X86
+        i = packFloatToRGBSSE2(p, out, count);
+#endif
+        for (; i < count; i++)
+        {
+            out[3 * i] = toByte(p[4 * i]);
+            out[3 * i + 1] = toByte(p[4 * i + 1]);
+            out[3 * i + 2] = toByte(p[4 * i + 2]);
+        }
+    }
+}
+
+/*
+ * Clamp to [0, 255] and drop the fraction, the same conversion the PPM writer does.
+ */
+uint8_t Framebuffer::toByte(double value)
+{
+    if (value >= 255.0)
+        return 255;
+    if (value <= 0.0)
+        return 0;
+    return (uint8_t)(value);
+}
+
+uint32_t Framebuffer::packRGBA8(const Color &c)
+{
+    return toByte(c.r) | (toByte(c.g) << 8) | (toByte(c.b) << 16) | 0xFF000000u;
+}
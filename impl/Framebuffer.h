@@ -0,0 +1,49 @@
+#ifndef __FRAMEBUFFER_H__
+#define __FRAMEBUFFER_H__
+
+#include <cstdint>
+#include <cstddef>
+#include "Color.h"
+
+#define FORMAT_RGBA8 0 // packed 8 bit channels, what ends up in the output files
+#define FORMAT_FLOAT 1 // 32 bit float channels, holding the same byte values as FORMAT_RGBA8
+
+/*
+ * Image storage in one aligned allocation.
+ * Rows are stored top row first, the order image files are written in,
+ * so pixel (x, y) lives in row height - 1 - y.
+ */
+class Framebuffer
+{
+public:
+    int width, height;
+    int format;
+
+    Framebuffer();
+    ~Framebuffer();
+
+    void initialize(int width, int height, int format);
+    void clear(const Color &c);
+
+    void setPixel(int x, int y, const Color &c);
+    Color getPixel(int x, int y) const;
+
+    uint32_t *rgba8Row(int y);
+    float *floatRow(int y);
+    const uint32_t *rgba8Row(int y) const;
+    const float *floatRow(int y) const;
+
+    void packRGB(uint8_t *out) const;
+
+    static uint8_t toByte(double value);
+    static uint32_t packRGBA8(const Color &c);
+
+private:
+    void *data;
+    size_t capacity;
+
+    Framebuffer(const Framebuffer &other);
+    Framebuffer &operator=(const Framebuffer &other);
+};
+
+#endif
@@ -1,219 +1,507 @@
-#include <iostream>
-#include <cmath>
-#include "Helpers.h"
-#include "Matrix4.h"
-#include "Vec3.h"
-#include "Vec4.h"
-
-using namespace std;
-
-/*
- * Calculate cross product of vec3 a, vec3 b and return resulting vec3.
- */
-Vec3 crossProductVec3(Vec3 a, Vec3 b)
-{
-    Vec3 result;
-
-    result.x = a.y * b.z - b.y * a.z;
-    result.y = b.x * a.z - a.x * b.z;
-    result.z = a.x * b.y - b.x * a.y;
-
-    return result;
-}
-
-/*
- * Calculate dot product of vec3 a, vec3 b and return resulting value.
- */
-double dotProductVec3(Vec3 a, Vec3 b)
-{
-    return a.x * b.x + a.y * b.y + a.z * b.z;
-}
-
-/*
- * Find length (|v|) of vec3 v.
- */
-double magnitudeOfVec3(Vec3 v)
-{
-    return sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
-}
-
-/*
- * Normalize the vec3 to make it unit vec3.
- */
-Vec3 normalizeVec3(Vec3 v)
-{
-    Vec3 result;
-    double d;
-
-    d = magnitudeOfVec3(v);
-    result.x = v.x / d;
-    result.y = v.y / d;
-    result.z = v.z / d;
-
-    return result;
-}
-
-/*
- * Return -v (inverse of vec3 v)
- */
-Vec3 inverseVec3(Vec3 v)
-{
-    Vec3 result;
-    result.x = -v.x;
-    result.y = -v.y;
-    result.z = -v.z;
-
-    return result;
-}
-
-/*
- * Add vec3 a to vec3 b and return resulting vec3 (a+b).
- */
-Vec3 addVec3(Vec3 a, Vec3 b)
-{
-    Vec3 result;
-    result.x = a.x + b.x;
-    result.y = a.y + b.y;
-    result.z = a.z + b.z;
-
-    return result;
-}
-
-/*
- * Subtract vec3 b from vec3 a and return resulting vec3 (a-b).
- */
-Vec3 subtractVec3(Vec3 a, Vec3 b)
-{
-    Vec3 result;
-    result.x = a.x - b.x;
-    result.y = a.y - b.y;
-    result.z = a.z - b.z;
-
-    return result;
-}
-
-/*
- * Multiply each element of vec3 with scalar.
- */
-Vec3 multiplyVec3WithScalar(Vec3 v, double c)
-{
-    Vec3 result;
-    result.x = v.x * c;
-    result.y = v.y * c;
-    result.z = v.z * c;
-
-    return result;
-}
-
-/*
- * Prints elements in a vec3. Can be used for debugging purposes.
- */
-void printVec3(Vec3 v)
-{
-    cout << "(" << v.x << "," << v.y << "," << v.z << ")" << endl;
-}
-
-/*
- * Check whether vec3 a and vec3 b are equal.
- * In case of equality, returns 1.
- * Otherwise, returns 0.
- */
-int areEqualVec3(Vec3 a, Vec3 b)
-{
-
-    /* if x difference, y difference and z difference is smaller than threshold, then they are equal */
-    if ((ABS((a.x - b.x)) < EPSILON) && (ABS((a.y - b.y)) < EPSILON) && (ABS((a.z - b.z)) < EPSILON))
-    {
-        return 1;
-    }
-    else
-    {
-        return 0;
-    }
-}
-
-/*
- * Returns an identity matrix (values on the diagonal are 1, others are 0).
-*/
-Matrix4 getIdentityMatrix()
-{
-    Matrix4 result;
-
-    for (int i = 0; i < 4; i++)
-    {
-        for (int j = 0; j < 4; j++)
-        {
-            if (i == j)
-            {
-                result.val[i][j] = 1.0;
-            }
-            else
-            {
-                result.val[i][j] = 0.0;
-            }
-        }
-    }
-
-    return result;
-}
-
-/*
- * Multiply matrices m1 (Matrix4) and m2 (Matrix4) and return the result matrix r (Matrix4).
- */
-Matrix4 multiplyMatrixWithMatrix(Matrix4 m1, Matrix4 m2)
-{
-    Matrix4 result;
-    double total;
-
-    for (int i = 0; i < 4; i++)
-    {
-        for (int j = 0; j < 4; j++)
-        {
-            total = 0;
-            for (int k = 0; k < 4; k++)
-            {
-                total += m1.val[i][k] * m2.val[k][j];
-            }
-
-            result.val[i][j] = total;
-        }
-    }
-
-    return result;
-}
-
-/*
- * Multiply matrix m (Matrix4) with vector v (vec4) and store the result in vector r (vec4).
- */
-Vec4 multiplyMatrixWithVec4(Matrix4 m, Vec4 v)
-{
-    double values[4];
-    double total;
-
-    for (int i = 0; i < 4; i++)
-    {
-        total = 0;
-        for (int j = 0; j < 4; j++)
-        {
-            total += m.val[i][j] * v.getElementAt(j);
-        }
-        values[i] = total;
-    }
-
-    return Vec4(values[0], values[1], values[2], values[3], v.colorId);
-}
-
-Color mix(const Color &f, const Color &s, double t){
-    double r = f.r * (1 - t) + s.r * t;
-    double g = f.g * (1 - t) + s.g * t;
-    double b = f.b * (1 - t) + s.b * t;
-    return Color(r,g,b);
-}
-
-Vec4 interpVec4(const Vec4 &f,const Vec4 &s, double t){
-    double x = f.x * (1 - t) + s.x * t;
-    double y = f.y * (1 - t) + s.y * t;
-    double z = f.z * (1 - t) + s.z * t;
-    double w = f.t * (1 - t) + s.t * t;
-    return Vec4(x,y,z,w,-1);
-}
+#include <iostream>
+#include <cmath>
+#include <algorithm>
+#include "Helpers.h"
+#include "Matrix4.h"
+#include "Vec3.h"
+#include "Vec4.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+/*
+ * Calculate cross product of vec3 a, vec3 b and return resulting vec3.
+ */
+Vec3 crossProductVec3(Vec3 a, Vec3 b)
+{
+    Vec3 result;
+
+    result.x = a.y * b.z - b.y * a.z;
+    result.y = b.x * a.z - a.x * b.z;
+    result.z = a.x * b.y - b.x * a.y;
+
+    return result;
+}
+
+/*
+ * Calculate dot product of vec3 a, vec3 b and return resulting value.
+ */
+double dotProductVec3(Vec3 a, Vec3 b)
+{
+    return a.x * b.x + a.y * b.y + a.z * b.z;
+}
+
+/*
+ * Find length (|v|) of vec3 v.
+ */
+double magnitudeOfVec3(Vec3 v)
+{
+    return sqrt(v.x * v.x + v.y * v.y + v.z * v.z);
+}
+
+/*
+ * Normalize the vec3 to make it unit vec3.
+ */
+Vec3 normalizeVec3(Vec3 v)
+{
+    Vec3 result;
+    double d;
+
+    d = magnitudeOfVec3(v);
+    result.x = v.x / d;
+    result.y = v.y / d;
+    result.z = v.z / d;
+
+    return result;
+}
+
+/*
+ * Return -v (inverse of vec3 v)
+ */
+Vec3 inverseVec3(Vec3 v)
+{
+    Vec3 result;
+    result.x = -v.x;
+    result.y = -v.y;
+    result.z = -v.z;
+
+    return result;
+}
+
+/*
+ * Add vec3 a to vec3 b and return resulting vec3 (a+b).
+ */
+Vec3 addVec3(Vec3 a, Vec3 b)
+{
+    Vec3 result;
+    result.x = a.x + b.x;
+    result.y = a.y + b.y;
+    result.z = a.z + b.z;
+
+    return result;
+}
+
+/*
+ * Subtract vec3 b from vec3 a and return resulting vec3 (a-b).
+ */
+Vec3 subtractVec3(Vec3 a, Vec3 b)
+{
+    Vec3 result;
+    result.x = a.x - b.x;
+    result.y = a.y - b.y;
+    result.z = a.z - b.z;
+
+    return result;
+}
+
+/*
+ * Multiply each element of vec3 with scalar.
+ */
+Vec3 multiplyVec3WithScalar(Vec3 v, double c)
+{
+    Vec3 result;
+    result.x = v.x * c;
+    result.y = v.y * c;
+    result.z = v.z * c;
+
+    return result;
+}
+
+/*
+ * Prints elements in a vec3. Can be used for debugging purposes.
+ */
+void printVec3(Vec3 v)
+{
+    cout << "(" << v.x << "," << v.y << "," << v.z << ")" << endl;
+}
+
+/*
+ * Check whether vec3 a and vec3 b are equal.
+ * In case of equality, returns 1.
+ * Otherwise, returns 0.
+ */
+int areEqualVec3(Vec3 a, Vec3 b)
+{
+
+    /* if x difference, y difference and z difference is smaller than threshold, then they are equal */
+    if ((ABS((a.x - b.x)) < EPSILON) && (ABS((a.y - b.y)) < EPSILON) && (ABS((a.z - b.z)) < EPSILON))
+    {
+        return 1;
+    }
+    else
+    {
+        return 0;
+    }
+}
+
+/*
+ * Returns an identity matrix (values on the diagonal are 1, others are 0).
+*/
+Matrix4 getIdentityMatrix()
+{
+    Matrix4 result;
+
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            if (i == j)
+            {
+                result.val[i][j] = 1.0;
+            }
+            else
+            {
+                result.val[i][j] = 0.0;
+            }
+        }
+    }
+
+    return result;
+}
+
+/*
+ * Multiply matrices m1 (Matrix4) and m2 (Matrix4) and return the result matrix r (Matrix4).
+ */
+Matrix4 multiplyMatrixWithMatrix(const Matrix4 &m1, const Matrix4 &m2)
+{
+    Matrix4 result;
+    double total;
+
+    for (int i = 0; i < 4; i++)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            total = 0;
+            for (int k = 0; k < 4; k++)
+            {
+                total += m1.val[i][k] * m2.val[k][j];
+            }
+
+            result.val[i][j] = total;
+        }
+    }
+
+    return result;
+}
+
+/*
+ * Multiply matrix m (Matrix4) with vector v (vec4) and store the result in vector r (vec4).
+ */
+Vec4 multiplyMatrixWithVec4(const Matrix4 &m, const Vec4 &v)
+{
+    double values[4];
+    double total;
+
+    for (int i = 0; i < 4; i++)
+    {
+        total = 0;
+        total += m.val[i][0] * v.x;
+        total += m.val[i][1] * v.y;
+        total += m.val[i][2] * v.z;
+        total += m.val[i][3] * v.t;
+        values[i] = total;
+    }
+
+    return Vec4(values[0], values[1], values[2], values[3], v.colorId);
+}
+
+/*
+ * Scalar transform of points [first, count), also used for vector tails.
+ * Sums start from 0 and add the terms in column order, like multiplyMatrixWithVec4.
+ */
+static void transformPointsScalar(const Matrix4 &m, const double *const in[4], double *const out[4],
+                                  int first, int count)
+{
+    for (int i = first; i < count; i++)
+    {
+        double w = in[3] ? in[3][i] : 1.0;
+        for (int r = 0; r < 4; r++)
+        {
+            double total = 0;
+            total += m.val[r][0] * in[0][i];
+            total += m.val[r][1] * in[1][i];
+            total += m.val[r][2] * in[2][i];
+            total += m.val[r][3] * w;
+            out[r][i] = total;
+        }
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/*
+ * Four points per iteration. Mul and add are kept separate, so no FMA changes the rounding.
+ */
+__attribute__((target("avx")))
+static int transformPointsAVX(const Matrix4 &m, const double *const in[4], double *const out[4], int count)
+{
+    int i = 0;
+    for (; i + 4 <= count; i += 4)
+    {
+        __m256d p[4];
+        p[0] = _mm256_loadu_pd(in[0] + i);
+        p[1] = _mm256_loadu_pd(in[1] + i);
+        p[2] = _mm256_loadu_pd(in[2] + i);
+        p[3] = in[3] ? _mm256_loadu_pd(in[3] + i) : _mm256_set1_pd(1.0);
+
+        for (int r = 0; r < 4; r++)
+        {
+            __m256d total = _mm256_setzero_pd();
+            for (int c = 0; c < 4; c++)
+            {
+                total = _mm256_add_pd(total, _mm256_mul_pd(_mm256_set1_pd(m.val[r][c]), p[c]));
+            }
+            _mm256_storeu_pd(out[r] + i, total);
+        }
+    }
+    return i;
+}
+
+/*
+ * Two points per iteration.
+ */
+static int transformPointsSSE2(const Matrix4 &m, const double *const in[4], double *const out[4], int count)
+{
+    int i = 0;
+    for (; i + 2 <= count; i += 2)
+    {
+        __m128d p[4];
+        p[0] = _mm_loadu_pd(in[0] + i);
+        p[1] = _mm_loadu_pd(in[1] + i);
+        p[2] = _mm_loadu_pd(in[2] + i);
+        p[3] = in[3] ? _mm_loadu_pd(in[3] + i) : _mm_set1_pd(1.0);
+
+        for (int r = 0; r < 4; r++)
+        {
+            __m128d total = _mm_setzero_pd();
+            for (int c = 0; c < 4; c++)
+            {
+                total = _mm_add_pd(total, _mm_mul_pd(_mm_set1_pd(m.val[r][c]), p[c]));
+            }
+            _mm_storeu_pd(out[r] + i, total);
+        }
+    }
+    return i;
+}
+
+static bool hasAVX()
+{
+    static const bool avx = (__builtin_cpu_init(), __builtin_cpu_supports("avx"));
+    return avx;
+}
+#endif
+
+void transformPoints(const Matrix4 &m, const double *const in[4], double *const out[4], int count)
+{
+    int done = 0;
+#if defined(__x86_64__) || defined(__i386__)
+    done = hasAVX() ? transformPointsAVX(m, in, out, count) : transformPointsSSE2(m, in, out, count);
+#endif
+    transformPointsScalar(m, in, out, done, count);
+}
+
+// determinants within this fraction of the size of their terms are rounding noise of an edge-on triangle
+#define BACKFACE_EPSILON 1e-10
+
+/*
+ * Whether the determinant of the x, y, w rows of a triangle is clearly negative.
+ * Every variant evaluates it in this order.
+ */
+static inline bool isBackfacing(double xa, double ya, double wa, double xb, double yb, double wb,
+                                double xc, double yc, double wc)
+{
+    double minorX = yb * wc - wb * yc;
+    double minorY = xb * wc - wb * xc;
+    double minorW = xb * yc - yb * xc;
+    double termX = xa * minorX, termY = ya * minorY, termW = wa * minorW;
+    double det = (termX - termY) + termW;
+    double size = (fabs(termX) + fabs(termY)) + fabs(termW);
+    return det < -BACKFACE_EPSILON * size;
+}
+
+static void backfacingTrianglesScalar(const double *const clip[4], const uint32_t *indices, int first, int count,
+                                      uint8_t *backfacing)
+{
+    const double *x = clip[0], *y = clip[1], *w = clip[3];
+    for (int t = first; t < count; t++)
+    {
+        uint32_t a = indices[3 * t], b = indices[3 * t + 1], c = indices[3 * t + 2];
+        backfacing[t] = isBackfacing(x[a], y[a], w[a], x[b], y[b], w[b], x[c], y[c], w[c]);
+    }
+}
+
+#if defined(__x86_64__) || defined(__i386__)
+/*
+ * base[index] for four indices. The masked form, as the plain one trips -Wmaybe-uninitialized.
+ */
+__attribute__((target("avx2")))
+static inline __m256d gather4(const double *base, __m128i index)
+{
+    return _mm256_mask_i32gather_pd(_mm256_setzero_pd(), base, index, _mm256_castsi256_pd(_mm256_set1_epi64x(-1)), 8);
+}
+
+/*
+ * Four triangles per iteration, corners fetched with gathers. No FMA, like transformPointsAVX.
+ */
+__attribute__((target("avx2")))
+static int backfacingTrianglesAVX2(const double *const clip[4], const uint32_t *indices, int count, uint8_t *backfacing)
+{
+    const __m256d signBit = _mm256_set1_pd(-0.0), epsilon = _mm256_set1_pd(-BACKFACE_EPSILON);
+    int t = 0;
+    for (; t + 4 <= count; t += 4)
+    {
+        const int *p = (const int *)(indices + 3 * t);
+        __m128i ia = _mm_setr_epi32(p[0], p[3], p[6], p[9]);
+        __m128i ib = _mm_setr_epi32(p[1], p[4], p[7], p[10]);
+        __m128i ic = _mm_setr_epi32(p[2], p[5], p[8], p[11]);
+
+        __m256d xa = gather4(clip[0], ia), ya = gather4(clip[1], ia), wa = gather4(clip[3], ia);
+        __m256d xb = gather4(clip[0], ib), yb = gather4(clip[1], ib), wb = gather4(clip[3], ib);
+        __m256d xc = gather4(clip[0], ic), yc = gather4(clip[1], ic), wc = gather4(clip[3], ic);
+
+        __m256d minorX = _mm256_sub_pd(_mm256_mul_pd(yb, wc), _mm256_mul_pd(wb, yc));
+        __m256d minorY = _mm256_sub_pd(_mm256_mul_pd(xb, wc), _mm256_mul_pd(wb, xc));
+        __m256d minorW = _mm256_sub_pd(_mm256_mul_pd(xb, yc), _mm256_mul_pd(yb, xc));
+        __m256d termX = _mm256_mul_pd(xa, minorX), termY = _mm256_mul_pd(ya, minorY), termW = _mm256_mul_pd(wa, minorW);
+        __m256d det = _mm256_add_pd(_mm256_sub_pd(termX, termY), termW);
+        __m256d size = _mm256_add_pd(_mm256_add_pd(_mm256_andnot_pd(signBit, termX), _mm256_andnot_pd(signBit, termY)),
+                                     _mm256_andnot_pd(signBit, termW));
+
+        int mask = _mm256_movemask_pd(_mm256_cmp_pd(det, _mm256_mul_pd(epsilon, size), _CMP_LT_OQ));
+        for (int k = 0; k < 4; k++)
+        {
+            backfacing[t + k] = (mask >> k) & 1;
+        }
+    }
+    return t;
+}
+
+/*
+ * Two triangles per iteration.
+ */
+static int backfacingTrianglesSSE2(const double *const clip[4], const uint32_t *indices, int count, uint8_t *backfacing)
+{
+    const double *x = clip[0], *y = clip[1], *w = clip[3];
+    const __m128d signBit = _mm_set1_pd(-0.0), epsilon = _mm_set1_pd(-BACKFACE_EPSILON);
+    int t = 0;
+    for (; t + 2 <= count; t += 2)
+    {
+        const uint32_t *p = indices + 3 * t;
+        __m128d xa = _mm_setr_pd(x[p[0]], x[p[3]]), ya = _mm_setr_pd(y[p[0]], y[p[3]]), wa = _mm_setr_pd(w[p[0]], w[p[3]]);
+        __m128d xb = _mm_setr_pd(x[p[1]], x[p[4]]), yb = _mm_setr_pd(y[p[1]], y[p[4]]), wb = _mm_setr_pd(w[p[1]], w[p[4]]);
+        __m128d xc = _mm_setr_pd(x[p[2]], x[p[5]]), yc = _mm_setr_pd(y[p[2]], y[p[5]]), wc = _mm_setr_pd(w[p[2]], w[p[5]]);
+
+        __m128d minorX = _mm_sub_pd(_mm_mul_pd(yb, wc), _mm_mul_pd(wb, yc));
+        __m128d minorY = _mm_sub_pd(_mm_mul_pd(xb, wc), _mm_mul_pd(wb, xc));
+        __m128d minorW = _mm_sub_pd(_mm_mul_pd(xb, yc), _mm_mul_pd(yb, xc));
+        __m128d termX = _mm_mul_pd(xa, minorX), termY = _mm_mul_pd(ya, minorY), termW = _mm_mul_pd(wa, minorW);
+        __m128d det = _mm_add_pd(_mm_sub_pd(termX, termY), termW);
+        __m128d size = _mm_add_pd(_mm_add_pd(_mm_andnot_pd(signBit, termX), _mm_andnot_pd(signBit, termY)),
+                                  _mm_andnot_pd(signBit, termW));
+
+        int mask = _mm_movemask_pd(_mm_cmplt_pd(det, _mm_mul_pd(epsilon, size)));
+        backfacing[t] = mask & 1;
+        backfacing[t + 1] = (mask >> 1) & 1;
+    }
+    return t;
+}
+
+static bool hasAVX2()
+{
+    static const bool avx2 = (__builtin_cpu_init(), __builtin_cpu_supports("avx2"));
+    return avx2;
+}
+#endif
+
+void backfacingTriangles(const double *const clip[4], const uint32_t *indices, int count, uint8_t *backfacing)
+{
+    int done = 0;
+#if defined(__x86_64__) || defined(__i386__)
+    done = hasAVX2() ? backfacingTrianglesAVX2(clip, indices, count, backfacing)
+                     : backfacingTrianglesSSE2(clip, indices, count, backfacing);
+#endif
+    backfacingTrianglesScalar(clip, indices, done, count, backfacing);
+}
+
+/*
+ * The terms with a zero coefficient add exactly nothing, so plane p evaluates to the
+ * same w + x, w - x, ... as testing the coordinates directly.
+ */
+void clipSpacePlanes(double planes[6][4])
+{
+    double values[6][4] = {
+        {1, 0, 0, 1},
+        {-1, 0, 0, 1},
+        {0, 1, 0, 1},
+        {0, -1, 0, 1},
+        {0, 0, 1, 1},
+        {0, 0, -1, 1}};
+
+    for (int p = 0; p < 6; p++)
+    {
+        for (int c = 0; c < 4; c++)
+        {
+            planes[p][c] = values[p][c];
+        }
+    }
+}
+
+/*
+ * Signed distance-like value of homogeneous point v to a clip plane. Non-negative means inside.
+ */
+double clipPlaneDistance(const Vec4 &v, const double plane[4])
+{
+    return plane[0] * v.x + plane[1] * v.y + plane[2] * v.z + plane[3] * v.t;
+}
+
+/*
+ * Bit mask of the clip planes that homogeneous point v is outside of, 0 if it is in the view volume.
+ */
+int clipOutcode(const Vec4 &v, const double planes[6][4])
+{
+    int code = 0;
+    for (int plane = 0; plane < 6; plane++)
+    {
+        if (clipPlaneDistance(v, planes[plane]) < 0)
+        {
+            code |= 1 << plane;
+        }
+    }
+    return code;
+}
+
+void transformClipPlanes(const double planes[6][4], const Matrix4 &m, double out[6][4])
+{
+    for (int p = 0; p < 6; p++)
+    {
+        for (int j = 0; j < 4; j++)
+        {
+            out[p][j] = 0;
+            for (int i = 0; i < 4; i++)
+            {
+                out[p][j] += planes[p][i] * m.val[i][j];
+            }
+        }
+    }
+}
+
+Color mix(const Color &f, const Color &s, double t){
+    double r = f.r * (1 - t) + s.r * t;
+    double g = f.g * (1 - t) + s.g * t;
+    double b = f.b * (1 - t) + s.b * t;
+    return Color(r,g,b);
+}
+
+Vec4 interpVec4(const Vec4 &f,const Vec4 &s, double t){
+    double x = f.x * (1 - t) + s.x * t;
+    double y = f.y * (1 - t) + s.y * t;
+    double z = f.z * (1 - t) + s.z * t;
+    double w = f.t * (1 - t) + s.t * t;
+    return Vec4(x,y,z,w,-1);
+}
+
+ClipVertex interpClipVertex(const ClipVertex &f, const ClipVertex &s, double t){
+    return ClipVertex(interpVec4(f.position, s.position, t), mix(f.color, s.color, t));
+}
@@ -1,84 +1,129 @@
-#ifndef __HELPERS_H__
-#define __HELPERS_H__
-
-#define ABS(a) ((a) > 0 ? (a) : -1 * (a))
-#define EPSILON 0.000000001
-
-#include "Matrix4.h"
-#include "Vec3.h"
-#include "Vec4.h"
-#include "Color.h"
-
-/*
- * Calculate cross product of vec3 a, vec3 b and return resulting vec3.
- */
-Vec3 crossProductVec3(Vec3 a, Vec3 b);
-
-/*
- * Calculate dot product of vec3 a, vec3 b and return resulting value.
- */
-double dotProductVec3(Vec3 a, Vec3 b);
-
-/*
- * Find length (|v|) of vec3 v.
- */
-double magnitudeOfVec3(Vec3 v);
-
-/*
- * Normalize the vec3 to make it unit vec3.
- */
-Vec3 normalizeVec3(Vec3 v);
-
-/*
- * Return -v (inverse of vec3 v)
- */
-Vec3 inverseVec3(Vec3 v);
-
-/*
- * Add vec3 a to vec3 b and return resulting vec3 (a+b).
- */
-Vec3 addVec3(Vec3 a, Vec3 b);
-
-/*
- * Subtract vec3 b from vec3 a and return resulting vec3 (a-b).
- */
-Vec3 subtractVec3(Vec3 a, Vec3 b);
-
-/*
- * Multiply each element of vec3 with scalar.
- */
-Vec3 multiplyVec3WithScalar(Vec3 v, double c);
-
-/*
- * Prints elements in a vec3. Can be used for debugging purposes.
- */
-void printVec3(Vec3 v);
-
-/*
- * Check whether vec3 a and vec3 b are equal.
- * In case of equality, returns 1.
- * Otherwise, returns 0.
- */
-int areEqualVec3(Vec3 a, Vec3 b);
-/*
- * Returns an identity matrix (values on the diagonal are 1, others are 0).
-*/
-Matrix4 getIdentityMatrix();
-
-/*
- * Multiply matrices m1 (Matrix4) and m2 (Matrix4) and return the result matrix r (Matrix4).
- */
-Matrix4 multiplyMatrixWithMatrix(Matrix4 m1, Matrix4 m2);
-
-/*
- * Multiply matrix m (Matrix4) with vector v (vec4) and store the result in vector r (vec4).
- */
-Vec4 multiplyMatrixWithVec4(Matrix4 m, Vec4 v);
-
-//mix colors using an interpolation value t.
-Color mix(const Color &a, const Color &b, double t);
-
-//mix vectors using an interpolation value t.
-Vec4 interpVec4(const Vec4 &f,const Vec4 &s, double t);
-
+#ifndef __HELPERS_H__
+#define __HELPERS_H__
+
+#define ABS(a) ((a) > 0 ? (a) : -1 * (a))
+#define EPSILON 0.000000001
+
+#include <cstdint>
+#include "Matrix4.h"
+#include "Vec3.h"
+#include "Vec4.h"
+#include "Color.h"
+#include "ClipVertex.h"
+
+/*
+ * Calculate cross product of vec3 a, vec3 b and return resulting vec3.
+ */
+Vec3 crossProductVec3(Vec3 a, Vec3 b);
+
+/*
+ * Calculate dot product of vec3 a, vec3 b and return resulting value.
+ */
+double dotProductVec3(Vec3 a, Vec3 b);
+
+/*
+ * Find length (|v|) of vec3 v.
+ */
+double magnitudeOfVec3(Vec3 v);
+
+/*
+ * Normalize the vec3 to make it unit vec3.
+ */
+Vec3 normalizeVec3(Vec3 v);
+
+/*
+ * Return -v (inverse of vec3 v)
+ */
+Vec3 inverseVec3(Vec3 v);
+
+/*
+ * Add vec3 a to vec3 b and return resulting vec3 (a+b).
+ */
+Vec3 addVec3(Vec3 a, Vec3 b);
+
+/*
+ * Subtract vec3 b from vec3 a and return resulting vec3 (a-b).
+ */
+Vec3 subtractVec3(Vec3 a, Vec3 b);
+
+/*
+ * Multiply each element of vec3 with scalar.
+ */
+Vec3 multiplyVec3WithScalar(Vec3 v, double c);
+
+/*
+ * Prints elements in a vec3. Can be used for debugging purposes.
+ */
+void printVec3(Vec3 v);
+
+/*
+ * Check whether vec3 a and vec3 b are equal.
+ * In case of equality, returns 1.
+ * Otherwise, returns 0.
+ */
+int areEqualVec3(Vec3 a, Vec3 b);
+/*
+ * Returns an identity matrix (values on the diagonal are 1, others are 0).
+*/
+Matrix4 getIdentityMatrix();
+
+/*
+ * Multiply matrices m1 (Matrix4) and m2 (Matrix4) and return the result matrix r (Matrix4).
+ */
+Matrix4 multiplyMatrixWithMatrix(const Matrix4 &m1, const Matrix4 &m2);
+
+/*
+ * Multiply matrix m (Matrix4) with vector v (vec4) and store the result in vector r (vec4).
+ */
+Vec4 multiplyMatrixWithVec4(const Matrix4 &m, const Vec4 &v);
+
+/*
+ * Multiply m with count points given as separate component arrays (x, y, z, w)
+ * and store the results in out. in[3] may be NULL, meaning w = 1 for every point.
+ * Results are bit-identical to multiplyMatrixWithVec4, with AVX or SSE2 when available.
+ */
+void transformPoints(const Matrix4 &m, const double *const in[4], double *const out[4], int count);
+
+/*
+ * Backface test of count triangles, given as three vertex indices each into the
+ * homogeneous clip coordinates clip (x, y, z, w arrays). Sets backfacing[t] to 1
+ * when the determinant of the x, y, w rows of triangle t is negative, which is when
+ * its world space normal points away from the eye, and to 0 otherwise. Needs no
+ * normalization and holds for corners behind the eye too. Edge-on triangles, whose
+ * determinant is only rounding noise, are kept. AVX2 or SSE2 when available,
+ * with the same result as the scalar code.
+ */
+void backfacingTriangles(const double *const clip[4], const uint32_t *indices, int count, uint8_t *backfacing);
+
+/*
+ * Coefficients of the six clip planes (x >= -w, x <= w, y >= -w, y <= w, z >= -w, z <= w).
+ * Plane p keeps homogeneous point v when planes[p] . v >= 0.
+ */
+void clipSpacePlanes(double planes[6][4]);
+
+/*
+ * Signed distance-like value of homogeneous point v to a clip plane. Non-negative means inside.
+ */
+double clipPlaneDistance(const Vec4 &v, const double plane[4]);
+
+/*
+ * Bit mask of the clip planes that homogeneous point v is outside of, 0 if it is in the view volume.
+ */
+int clipOutcode(const Vec4 &v, const double planes[6][4]);
+
+/*
+ * Pulls planes back through m: out[p] keeps point v exactly when planes[p] keeps m * v.
+ * With m the model-to-screen matrix of a mesh this gives its clip planes in object space.
+ */
+void transformClipPlanes(const double planes[6][4], const Matrix4 &m, double out[6][4]);
+
+//mix colors using an interpolation value t.
+Color mix(const Color &a, const Color &b, double t);
+
+//mix vectors using an interpolation value t.
+Vec4 interpVec4(const Vec4 &f,const Vec4 &s, double t);
+
+//mix position and color of clip vertices using an interpolation value t.
+ClipVertex interpClipVertex(const ClipVertex &f, const ClipVertex &s, double t);
+
 #endif
\ No newline at end of file
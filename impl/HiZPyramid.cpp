@@ -0,0 +1,85 @@
+#include "HiZPyramid.h"
+#include <algorithm>
+
+using namespace std;
+
+HiZPyramid::HiZPyramid()
+{
+}
+
+void HiZPyramid::build(const DepthBuffer &depthBuffer)
+{
+    int width = depthBuffer.tilesX, height = depthBuffer.tilesY;
+
+    levels.resize(1);
+    widths.assign(1, width);
+    heights.assign(1, height);
+    levels[0] = depthBuffer.tileMax;
+
+    while (width > 1 || height > 1)
+    {
+        int nextWidth = (width + 1) / 2, nextHeight = (height + 1) / 2;
+        const vector<double> &below = levels.back();
+        vector<double> level(nextWidth * nextHeight);
+
+        for (int y = 0; y < nextHeight; y++)
+        {
+            int y0 = 2 * y, y1 = min(2 * y + 1, height - 1);
+            for (int x = 0; x < nextWidth; x++)
+            {
+                int x0 = 2 * x, x1 = min(2 * x + 1, width - 1);
+                level[x + y * nextWidth] = max(max(below[x0 + y0 * width], below[x1 + y0 * width]),
+                                               max(below[x0 + y1 * width], below[x1 + y1 * width]));
+            }
+        }
+
+        levels.push_back(level);
+        widths.push_back(nextWidth);
+        heights.push_back(nextHeight);
+        width = nextWidth;
+        height = nextHeight;
+    }
+}
+
+void HiZPyramid::clear()
+{
+    levels.clear();
+    widths.clear();
+    heights.clear();
+}
+
+bool HiZPyramid::isEmpty() const
+{
+    return levels.empty();
+}
+
+bool HiZPyramid::isOccluded(int minX, int minY, int maxX, int maxY, double minZ) const
+{
+    if (isEmpty() || minX > maxX || minY > maxY)
+    {
+        return false;
+    }
+
+    int tx0 = max(minX, 0) / DEPTH_TILE_SIZE, tx1 = min(maxX / DEPTH_TILE_SIZE, widths[0] - 1);
+    int ty0 = max(minY, 0) / DEPTH_TILE_SIZE, ty1 = min(maxY / DEPTH_TILE_SIZE, heights[0] - 1);
+
+    // finest level where the rectangle spans at most two texels each way
+    int level = 0;
+    while (level + 1 < (int)levels.size() && ((tx1 >> level) - (tx0 >> level) > 1 || (ty1 >> level) - (ty0 >> level) > 1))
+    {
+        level++;
+    }
+
+    const vector<double> &texels = levels[level];
+    for (int y = ty0 >> level; y <= ty1 >> level; y++)
+    {
+        for (int x = tx0 >> level; x <= tx1 >> level; x++)
+        {
+            if (!(minZ > texels[x + y * widths[level]]))
+            {
+                return false;
+            }
+        }
+    }
+    return true;
+}
@@ -0,0 +1,34 @@
+#ifndef __HIZPYRAMID_H__
+#define __HIZPYRAMID_H__
+
+#include <vector>
+#include "DepthBuffer.h"
+
+using namespace std;
+
+/*
+ * Farthest depth pyramid over a DepthBuffer. Level 0 is the tileMax of every
+ * depth tile, each next level holds the maximum of 2 x 2 texels of the one
+ * below, so any screen rectangle is covered by at most 2 x 2 texels of some level.
+ */
+class HiZPyramid
+{
+public:
+    vector< vector<double> > levels;
+    vector<int> widths, heights;
+
+    HiZPyramid();
+
+    void build(const DepthBuffer &depthBuffer);
+    void clear();
+    bool isEmpty() const;
+
+    /*
+     * Whether everything in the pixel rectangle [minX, maxX] x [minY, maxY] at
+     * depth minZ or farther is behind what the depth buffer holds, so would
+     * fail the depth test.
+     */
+    bool isOccluded(int minX, int minY, int maxX, int maxY, double minZ) const;
+};
+
+#endif
@@ -2,6 +2,7 @@
 #include <string>
 #include <vector>
 #include "Scene.h"
+#include "SceneCache.h"
 #include "Matrix4.h"
 #include "Helpers.h"
 
@@ -9,36 +10,160 @@ using namespace std;
 
 Scene *scene;
 
+void printUsage()
+{
+    cout << "Please run the rasterizer as:" << endl
+         << "\t./rasterizer <input_file_name> [options]" << endl
+         << "Options:" << endl
+         << "\t--no-depth-test\tdraw solid meshes in input order, without a depth buffer" << endl
+         << "\t--threads=<n>\tnumber of rasterizer threads (default: all cores)" << endl
+         << "\t--isa=<scalar|sse2|avx2>\twidest SIMD kernel to use (default: avx2 when supported)" << endl
+         << "\t--framebuffer=<rgba8|float>\tframebuffer storage format (default: rgba8)" << endl
+         << "\t--ppm=<p3|p6>\tASCII or binary PPM output (default: p3)" << endl
+         << "\t--output=<ppm|png|both>\timage files to write, PNG files are named <output>.png (default: ppm)" << endl
+         << "\t--compile-scene\tparse the XML and write its binary cache <input_file_name>.cache, without rendering" << endl
+         << "\t--no-scene-cache\tparse the XML even if an up to date cache exists" << endl
+         << "\t--no-bvh\tcull large meshes as a whole only, without building or using their BVH" << endl
+         << "\t--occlusion-culling\tskip solid meshes hidden behind those drawn before them" << endl
+         << "\t--front-to-back\tdraw solid meshes nearest first, then the wireframes in input order" << endl
+         << "\t--stats=json\tprint per camera counters and stage times to stdout as JSON" << endl;
+}
+
 int main(int argc, char *argv[])
 {
-    if (argc != 2)
+    bool depthTest = true;
+    int threads = 0;
+    int isa = ISA_AVX2;
+    int format = FORMAT_RGBA8;
+    int ppm = PPM_P3;
+    bool writePPM = true, writePNG = false;
+    bool useSceneCache = true, compileScene = false;
+    bool printStats = false;
+    bool useBvh = true;
+    bool occlusionCulling = false;
+    bool frontToBack = false;
+
+    for (int i = 2; i < argc; i++)
     {
-        cout << "Please run the rasterizer as:" << endl
-             << "\t./rasterizer <input_file_name>" << endl;
+        string arg = argv[i];
+
+        if (arg == "--no-depth-test")
+        {
+            depthTest = false;
+        }
+        else if (arg.compare(0, 10, "--threads=") == 0 && atoi(arg.c_str() + 10) > 0)
+        {
+            threads = atoi(arg.c_str() + 10);
+        }
+        else if (arg == "--isa=scalar")
+        {
+            isa = ISA_SCALAR;
+        }
+        else if (arg == "--isa=sse2")
+        {
+            isa = ISA_SSE2;
+        }
+        else if (arg == "--isa=avx2")
+        {
+            isa = ISA_AVX2;
+        }
+        else if (arg == "--framebuffer=rgba8")
+        {
+            format = FORMAT_RGBA8;
+        }
+        else if (arg == "--framebuffer=float")
+        {
+            format = FORMAT_FLOAT;
+        }
+        else if (arg == "--ppm=p3")
+        {
+            ppm = PPM_P3;
+        }
+        else if (arg == "--ppm=p6")
+        {
+            ppm = PPM_P6;
+        }
+        else if (arg == "--output=ppm" || arg == "--output=png" || arg == "--output=both")
+        {
+            writePPM = arg != "--output=png";
+            writePNG = arg != "--output=ppm";
+        }
+        else if (arg == "--compile-scene")
+        {
+            compileScene = true;
+        }
+        else if (arg == "--no-scene-cache")
+        {
+            useSceneCache = false;
+        }
+        else if (arg == "--no-bvh")
+        {
+            useBvh = false;
+        }
+        else if (arg == "--occlusion-culling")
+        {
+            occlusionCulling = true;
+        }
+        else if (arg == "--front-to-back")
+        {
+            frontToBack = true;
+        }
+        else if (arg == "--stats=json")
+        {
+            printStats = true;
+        }
+        else
+        {
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (argc < 2)
+    {
+        printUsage();
         return 1;
     }
     else
     {
         const char *xmlPath = argv[1];
 
-        scene = new Scene(xmlPath);
+        // compiling always parses, so a stale or broken cache is replaced
+        scene = new Scene(xmlPath, useSceneCache && !compileScene);
+        scene->bvhEnabled = useBvh;
+        if (threads > 0)
+        {
+            scene->rasterThreads = threads;
+        }
 
-        for (int i = 0; i < scene->cameras.size(); i++)
+        if (compileScene)
         {
-            // initialize image with basic values
-            scene->initializeImage(scene->cameras[i]);
+            // the cache stores the BVHs too, so later runs skip building them
+            if (useBvh)
+            {
+                scene->buildMeshBvhs();
+            }
+            if (!SceneCache::write(*scene, xmlPath))
+            {
+                cerr << "cannot write " << SceneCache::pathFor(xmlPath) << endl;
+                return 1;
+            }
+            return 0;
+        }
 
-            // do forward rendering pipeline operations
-            scene->forwardRenderingPipeline(scene->cameras[i]);
+        scene->depthTestEnabled = depthTest;
+        scene->occlusionCullingEnabled = occlusionCulling;
+        scene->frontToBackEnabled = frontToBack;
+        scene->rasterIsa = isa;
+        scene->imageFormat = format;
+        scene->ppmFormat = ppm;
 
-            // generate PPM file
-            scene->writeImageToPPMFile(scene->cameras[i]);
+        // render every camera and write its images
+        scene->renderCameras(writePPM, writePNG);
 
-            // Converts PPM image in given path to PNG file, by calling ImageMagick's 'convert' command.
-            // Notice that os_type is not given as 1 (Ubuntu) or 2 (Windows), below call doesn't do conversion.
-            // Change os_type to 1 or 2, after being sure that you have ImageMagick installed.
-            scene->convertPPMToPNG(scene->cameras[i]->outputFileName, 99);
-            // return 0;
+        if (printStats)
+        {
+            scene->writeStatsJson(cout, xmlPath);
         }
 
         return 0;
@@ -0,0 +1,65 @@
+#include "MappedFile.h"
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+MappedFile::MappedFile()
+{
+    this->data = NULL;
+    this->size = 0;
+}
+
+MappedFile::~MappedFile()
+{
+    close();
+}
+
+/*
+ * Map path into memory. Returns false if it cannot be opened; an empty file
+ * maps successfully with size 0 and no data.
+ */
+bool MappedFile::open(const string &path)
+{
+    close();
+
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat info;
+    if (fstat(fd, &info) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    if (info.st_size > 0)
+    {
+        void *mapped = mmap(NULL, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (mapped == MAP_FAILED)
+        {
+            ::close(fd);
+            return false;
+        }
+        madvise(mapped, info.st_size, MADV_SEQUENTIAL);
+        data = (const char *)mapped;
+        size = info.st_size;
+    }
+
+    // the mapping stays valid after the descriptor is closed
+    ::close(fd);
+    return true;
+}
+
+void MappedFile::close()
+{
+    if (data != NULL)
+    {
+        munmap((void *)data, size);
+    }
+    data = NULL;
+    size = 0;
+}
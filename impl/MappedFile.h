@@ -0,0 +1,30 @@
+#ifndef __MAPPEDFILE_H__
+#define __MAPPEDFILE_H__
+
+#include <cstddef>
+#include <string>
+
+using namespace std;
+
+/*
+ * Read-only memory mapping of a whole file. The pages are loaded by the OS on
+ * first touch, so large files are never copied into the heap.
+ */
+class MappedFile
+{
+public:
+    const char *data;
+    size_t size;
+
+    MappedFile();
+    ~MappedFile();
+
+    bool open(const string &path);
+    void close();
+
+private:
+    MappedFile(const MappedFile &other);
+    MappedFile &operator=(const MappedFile &other);
+};
+
+#endif
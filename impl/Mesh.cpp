@@ -3,10 +3,14 @@
 #include "Mesh.h"
 #include <iostream>
 #include <iomanip>
+#include <algorithm>
 
 using namespace std;
 
-Mesh::Mesh() {}
+Mesh::Mesh()
+{
+    this->transformNode = 0;
+}
 
 Mesh::Mesh(int meshId, int type, int numberOfTransformations,
              vector<int> transformationIds,
@@ -18,10 +22,63 @@ Mesh::Mesh(int meshId, int type, int numberOfTransformations,
     this->type = type;
     this->numberOfTransformations = numberOfTransformations;
     this->numberOfTriangles = numberOfTriangles;
+    this->transformNode = 0;
 
     this->transformationIds = transformationIds;
     this->transformationTypes = transformationTypes;
-    this->triangles = triangles;
+    this->indices.reserve(triangles.size() * 3);
+    for (int i = 0; i < triangles.size(); i++) {
+        addTriangle(triangles[i].vertexIds[0], triangles[i].vertexIds[1], triangles[i].vertexIds[2]);
+    }
+    collectVertexIndices();
+}
+
+/*
+ * Append a triangle given by 1-based vertex ids, as in the scene file.
+ */
+void Mesh::addTriangle(int vid1, int vid2, int vid3)
+{
+    indices.push_back(vid1 - 1);
+    indices.push_back(vid2 - 1);
+    indices.push_back(vid3 - 1);
+}
+
+/*
+ * Fill vertexIndices with every vertex index used by the triangles, once each.
+ * Lets the pipeline transform shared vertices a single time per camera.
+ */
+void Mesh::collectVertexIndices()
+{
+    vertexIndices = indices;
+
+    sort(vertexIndices.begin(), vertexIndices.end());
+    vertexIndices.erase(unique(vertexIndices.begin(), vertexIndices.end()), vertexIndices.end());
+
+    indexView = Span<const uint32_t>(indices);
+    vertexIndexView = Span<const uint32_t>(vertexIndices);
+}
+
+/*
+ * Use index arrays owned elsewhere, laid out like indices and vertexIndices.
+ * They must outlive the mesh.
+ */
+void Mesh::useExternal(Span<const uint32_t> indices, Span<const uint32_t> vertexIndices)
+{
+    this->indices.clear();
+    this->vertexIndices.clear();
+    indexView = indices;
+    vertexIndexView = vertexIndices;
+    numberOfTriangles = indices.size() / 3;
+}
+
+Span<const uint32_t> Mesh::getIndices() const
+{
+    return indexView;
+}
+
+Span<const uint32_t> Mesh::getVertexIndices() const
+{
+    return vertexIndexView;
 }
 
 ostream &operator<<(ostream &os, const Mesh &m)
@@ -40,8 +97,9 @@ ostream &operator<<(ostream &os, const Mesh &m)
     os << fixed << setprecision(3) << m.numberOfTransformations << " transformations and " << m.numberOfTriangles << " triangles"
        << endl << "\tTriangles are:" << endl << fixed << setprecision(0);
 
-    for (int i = 0; i < m.triangles.size(); i++) {
-        os << "\t\t" << m.triangles[i].vertexIds[0] << " " << m.triangles[i].vertexIds[1] << " " << m.triangles[i].vertexIds[2] << endl;
+    Span<const uint32_t> indices = m.getIndices();
+    for (int i = 0; i + 2 < indices.size(); i += 3) {
+        os << "\t\t" << indices[i] + 1 << " " << indices[i + 1] + 1 << " " << indices[i + 2] + 1 << endl;
     }
 
     return os;
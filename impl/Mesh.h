@@ -2,6 +2,10 @@
 #define __MESH_H__
 
 #include <vector>
+#include <cstdint>
+#include "Bounds.h"
+#include "Bvh.h"
+#include "Span.h"
 #include "Triangle.h"
 #include <iostream>
 
@@ -16,8 +20,13 @@ public:
     int numberOfTransformations;
     vector<int> transformationIds;
     vector<char> transformationTypes;
+    int transformNode; // composed model matrix in Scene::transformCache
     int numberOfTriangles;
-    vector<Triangle> triangles;
+    vector<uint32_t> indices; // 3 vertex indices (vertexId-1) per triangle, when parsed
+    vector<uint32_t> vertexIndices; // unique vertex indices referenced by triangles
+    Bounds bounds; // object space, see Scene::buildMeshBounds
+    double sortCenter[3], sortRadius; // world space sphere around the bounds, the front-to-back sort key
+    Bvh bvh; // over the triangles of large meshes, see Scene::buildMeshBvhs
 
     Mesh();
     Mesh(int meshId, int type, int numberOfTransformations,
@@ -26,7 +35,19 @@ public:
           int numberOfTriangles,
           vector<Triangle> triangles);
 
+    void addTriangle(int vid1, int vid2, int vid3);
+    void collectVertexIndices();
+    void useExternal(Span<const uint32_t> indices, Span<const uint32_t> vertexIndices);
+
+    Span<const uint32_t> getIndices() const;
+    Span<const uint32_t> getVertexIndices() const;
+
     friend ostream &operator<<(ostream &os, const Mesh &m);
+
+private:
+    // what the pipeline reads, the vectors above or arrays of a mapped scene cache
+    Span<const uint32_t> indexView;
+    Span<const uint32_t> vertexIndexView;
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,112 @@
+#include "NumberScanner.h"
+#include <charconv>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+void NumberScanner::skipSpace(const char *&p, const char *end)
+{
+    while (p < end && (*p == ' ' || *p == '\t' || *p == '\n' || *p == '\r'))
+    {
+        p++;
+    }
+}
+
+bool NumberScanner::scanDouble(const char *&p, const char *end, double &value)
+{
+    skipSpace(p, end);
+
+    // from_chars does not take the leading '+' that strtod accepts
+    const char *start = p;
+    if (start < end && *start == '+')
+    {
+        start++;
+    }
+
+    from_chars_result result = from_chars(start, end, value);
+    if (result.ec != errc() || result.ptr == start)
+    {
+        return false;
+    }
+    p = result.ptr;
+    return true;
+}
+
+#ifdef __SSE2__
+/*
+ * Length of the run of digits at p, up to 16. At least 16 bytes must be readable.
+ */
+static int digitRun16(const char *p)
+{
+    __m128i chunk = _mm_loadu_si128((const __m128i *)p);
+    __m128i below = _mm_cmplt_epi8(chunk, _mm_set1_epi8('0'));
+    __m128i above = _mm_cmpgt_epi8(chunk, _mm_set1_epi8('9'));
+    unsigned mask = _mm_movemask_epi8(_mm_or_si128(below, above)) | 0x10000;
+    return __builtin_ctz(mask);
+}
+
+/*
+ * Value of the length (1 to 8) digits at p, combining pairs, then quads, then
+ * the two halves inside one 64 bit word. At least 8 bytes must be readable.
+ */
+static uint32_t parseDigits8(const char *p, int length)
+{
+    uint64_t v;
+    memcpy(&v, p, 8);
+    v -= 0x3030303030303030ULL;
+    v <<= 8 * (8 - length); // right-align the digits, zeros in front
+    v = (v * 10) + (v >> 8);
+    v = (((v & 0x000000FF000000FFULL) * (100 + (1000000ULL << 32))) +
+         (((v >> 16) & 0x000000FF000000FFULL) * (1 + (10000ULL << 32)))) >> 32;
+    return (uint32_t)v;
+}
+#endif
+
+bool NumberScanner::scanInt(const char *&p, const char *end, int &value)
+{
+    skipSpace(p, end);
+
+    const char *start = p;
+    bool negative = false;
+    if (start < end && (*start == '+' || *start == '-'))
+    {
+        negative = *start == '-';
+        start++;
+    }
+
+#ifdef __SSE2__
+    if (end - start >= 16)
+    {
+        int length = digitRun16(start);
+        if (length == 0)
+        {
+            return false;
+        }
+        if (length <= 8)
+        {
+            int digits = parseDigits8(start, length);
+            value = negative ? -digits : digits;
+            p = start + length;
+            return true;
+        }
+    }
+#endif
+
+    // long runs and the last bytes of the buffer
+    if (start == end || *start < '0' || *start > '9')
+    {
+        return false;
+    }
+    unsigned int digits;
+    from_chars_result result = from_chars(start, end, digits);
+    if (result.ec != errc() || digits > (negative ? 2147483648U : 2147483647U))
+    {
+        return false;
+    }
+    value = negative ? (int)(0U - digits) : (int)digits;
+    p = result.ptr;
+    return true;
+}
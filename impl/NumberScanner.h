@@ -0,0 +1,29 @@
+#ifndef __NUMBERSCANNER_H__
+#define __NUMBERSCANNER_H__
+
+using namespace std;
+
+/*
+ * Locale independent number scanning over [p, end) ranges, for the scene loader.
+ * Each function skips leading whitespace, reads one number and moves p past
+ * it, or leaves p unchanged and returns false if no number starts there.
+ */
+class NumberScanner
+{
+public:
+    /*
+     * Decimal or scientific notation, correctly rounded, so the result is
+     * bit-identical to strtod in the C locale.
+     */
+    static bool scanDouble(const char *&p, const char *end, double &value);
+
+    /*
+     * Optionally signed decimal integer. Short digit runs, such as face
+     * indices, are classified with SSE2 and converted without a digit loop.
+     */
+    static bool scanInt(const char *&p, const char *end, int &value);
+
+    static void skipSpace(const char *&p, const char *end);
+};
+
+#endif
@@ -0,0 +1,367 @@
+#include "PngWriter.h"
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+#define PNG_BAND_BYTES (256 * 1024) // filtered bytes per independently compressed band
+#define DEFLATE_WINDOW 32768
+#define DEFLATE_HASH_BITS 15
+#define DEFLATE_MAX_CHAIN 32
+#define DEFLATE_MIN_MATCH 3
+#define DEFLATE_MAX_MATCH 258
+
+static const int lengthBase[29] = {3, 4, 5, 6, 7, 8, 9, 10, 11, 13, 15, 17, 19, 23, 27, 31,
+                                   35, 43, 51, 59, 67, 83, 99, 115, 131, 163, 195, 227, 258};
+static const int lengthExtra[29] = {0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 2, 2, 2, 2,
+                                    3, 3, 3, 3, 4, 4, 4, 4, 5, 5, 5, 5, 0};
+static const int distanceBase[30] = {1, 2, 3, 4, 5, 7, 9, 13, 17, 25, 33, 49, 65, 97, 129, 193,
+                                     257, 385, 513, 769, 1025, 1537, 2049, 3073, 4097, 6145, 8193, 12289, 16385, 24577};
+static const int distanceExtra[30] = {0, 0, 0, 0, 1, 1, 2, 2, 3, 3, 4, 4, 5, 5, 6, 6,
+                                      7, 7, 8, 8, 9, 9, 10, 10, 11, 11, 12, 12, 13, 13};
+
+/*
+ * Deflate streams are packed least significant bit first.
+ */
+class BitWriter
+{
+public:
+    vector<uint8_t> bytes;
+    uint64_t buffer = 0;
+    int count = 0;
+
+    void put(uint32_t bits, int n)
+    {
+        buffer |= (uint64_t)bits << count;
+        count += n;
+        while (count >= 8)
+        {
+            bytes.push_back(buffer & 0xFF);
+            buffer >>= 8;
+            count -= 8;
+        }
+    }
+
+    // Huffman codes are defined most significant bit first
+    void putCode(uint32_t code, int n)
+    {
+        uint32_t reversed = 0;
+        for (int i = 0; i < n; i++)
+        {
+            reversed |= ((code >> i) & 1) << (n - 1 - i);
+        }
+        put(reversed, n);
+    }
+
+    void alignToByte()
+    {
+        if (count > 0)
+        {
+            put(0, 8 - count);
+        }
+    }
+};
+
+/*
+ * Fixed Huffman code of a literal/length symbol (RFC 1951, 3.2.6).
+ */
+static void putLiteral(BitWriter &out, int symbol)
+{
+    if (symbol < 144)
+        out.putCode(0x30 + symbol, 8);
+    else if (symbol < 256)
+        out.putCode(0x190 + symbol - 144, 9);
+    else if (symbol < 280)
+        out.putCode(symbol - 256, 7);
+    else
+        out.putCode(0xC0 + symbol - 280, 8);
+}
+
+static void putMatch(BitWriter &out, int length, int distance)
+{
+    int l = 28;
+    while (lengthBase[l] > length)
+        l--;
+    putLiteral(out, 257 + l);
+    out.put(length - lengthBase[l], lengthExtra[l]);
+
+    int d = 29;
+    while (distanceBase[d] > distance)
+        d--;
+    out.putCode(d, 5);
+    out.put(distance - distanceBase[d], distanceExtra[d]);
+}
+
+/*
+ * Compresses one band as a fixed Huffman block. Matches never reach outside
+ * the band, so bands are independent. A non-final band ends with an empty
+ * stored block to realign to a byte boundary, so that bands can be concatenated.
+ */
+static void deflateBand(const uint8_t *data, int size, bool last, BitWriter &out)
+{
+    vector<int> head(1 << DEFLATE_HASH_BITS, -1);
+    vector<int> prev(size);
+
+    out.put(last ? 1 : 0, 1);
+    out.put(1, 2);
+
+    int i = 0;
+    while (i < size)
+    {
+        int bestLength = 0, bestDistance = 0;
+
+        if (i + DEFLATE_MIN_MATCH <= size)
+        {
+            uint32_t hash = ((data[i] << 16) | (data[i + 1] << 8) | data[i + 2]) * 2654435761u >> (32 - DEFLATE_HASH_BITS);
+            int maxLength = min(DEFLATE_MAX_MATCH, size - i);
+
+            for (int candidate = head[hash], chain = 0;
+                 candidate >= 0 && i - candidate <= DEFLATE_WINDOW && chain < DEFLATE_MAX_CHAIN;
+                 candidate = prev[candidate], chain++)
+            {
+                int length = 0;
+                while (length < maxLength && data[candidate + length] == data[i + length])
+                    length++;
+
+                if (length > bestLength)
+                {
+                    bestLength = length;
+                    bestDistance = i - candidate;
+                    if (length == maxLength)
+                        break;
+                }
+            }
+
+            prev[i] = head[hash];
+            head[hash] = i;
+        }
+
+        if (bestLength >= DEFLATE_MIN_MATCH)
+        {
+            putMatch(out, bestLength, bestDistance);
+
+            // index the skipped positions so later matches can find them
+            for (int k = i + 1; k < i + bestLength && k + DEFLATE_MIN_MATCH <= size; k++)
+            {
+                uint32_t hash = ((data[k] << 16) | (data[k + 1] << 8) | data[k + 2]) * 2654435761u >> (32 - DEFLATE_HASH_BITS);
+                prev[k] = head[hash];
+                head[hash] = k;
+            }
+            i += bestLength;
+        }
+        else
+        {
+            putLiteral(out, data[i]);
+            i++;
+        }
+    }
+
+    putLiteral(out, 256);
+
+    if (!last)
+    {
+        out.put(0, 3);
+        out.alignToByte();
+        out.put(0x0000, 16);
+        out.put(0xFFFF, 16);
+    }
+    out.alignToByte();
+}
+
+static int paeth(int a, int b, int c)
+{
+    int p = a + b - c;
+    int pa = abs(p - a), pb = abs(p - b), pc = abs(p - c);
+    if (pa <= pb && pa <= pc)
+        return a;
+    if (pb <= pc)
+        return b;
+    return c;
+}
+
+/*
+ * Writes the filter type byte and filtered bytes of one row, picking the
+ * filter with the smallest sum of absolute differences.
+ */
+static void filterRow(const uint8_t *row, const uint8_t *above, int stride, uint8_t *out, vector<uint8_t> &trial)
+{
+    long bestScore = -1;
+    int bestFilter = 0;
+
+    for (int filter = 0; filter < 5; filter++)
+    {
+        long score = 0;
+        for (int i = 0; i < stride; i++)
+        {
+            int a = i >= 3 ? row[i - 3] : 0;
+            int b = above ? above[i] : 0;
+            int c = above && i >= 3 ? above[i - 3] : 0;
+            int predicted = 0;
+
+            if (filter == 1)
+                predicted = a;
+            else if (filter == 2)
+                predicted = b;
+            else if (filter == 3)
+                predicted = (a + b) / 2;
+            else if (filter == 4)
+                predicted = paeth(a, b, c);
+
+            trial[i] = (uint8_t)(row[i] - predicted);
+            score += (int8_t)trial[i] < 0 ? -(int8_t)trial[i] : trial[i];
+        }
+
+        if (bestScore < 0 || score < bestScore)
+        {
+            bestScore = score;
+            bestFilter = filter;
+            memcpy(out + 1, trial.data(), stride);
+        }
+    }
+
+    out[0] = bestFilter;
+}
+
+static vector<uint32_t> makeCrcTable()
+{
+    vector<uint32_t> table(256);
+    for (uint32_t n = 0; n < 256; n++)
+    {
+        uint32_t c = n;
+        for (int k = 0; k < 8; k++)
+            c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+        table[n] = c;
+    }
+    return table;
+}
+
+static uint32_t crc32(const uint8_t *data, size_t size, uint32_t crc = 0)
+{
+    static const vector<uint32_t> table = makeCrcTable();
+
+    crc = ~crc;
+    for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return ~crc;
+}
+
+static uint32_t adler32(const uint8_t *data, size_t size)
+{
+    uint32_t a = 1, b = 0;
+    while (size > 0)
+    {
+        // 5552 bytes is the most that can be summed before the modulo is due
+        size_t n = min(size, (size_t)5552);
+        for (size_t i = 0; i < n; i++)
+        {
+            a += data[i];
+            b += a;
+        }
+        a %= 65521;
+        b %= 65521;
+        data += n;
+        size -= n;
+    }
+    return (b << 16) | a;
+}
+
+static void putBigEndian(vector<uint8_t> &out, uint32_t value)
+{
+    out.push_back(value >> 24);
+    out.push_back(value >> 16);
+    out.push_back(value >> 8);
+    out.push_back(value);
+}
+
+static void putChunk(vector<uint8_t> &out, const char *type, const uint8_t *data, size_t size)
+{
+    putBigEndian(out, size);
+    size_t start = out.size();
+    out.insert(out.end(), type, type + 4);
+    out.insert(out.end(), data, data + size);
+    putBigEndian(out, crc32(out.data() + start, size + 4));
+}
+
+/*
+ * Encodes width x height pixels of packed RGB (top row first) and writes them
+ * to fileName. Bands are filtered and compressed on pool when it is given.
+ * The size of the file goes to bytesWritten when that is given.
+ */
+bool PngWriter::write(const string &fileName, int width, int height, const uint8_t *rgb, ThreadPool *pool, size_t *bytesWritten)
+{
+    int stride = width * 3;
+    int rowsPerBand = max(1, PNG_BAND_BYTES / (stride + 1));
+    int bandCount = (height + rowsPerBand - 1) / rowsPerBand;
+
+    vector<uint8_t> filtered((size_t)(stride + 1) * height);
+    vector<BitWriter> bands(bandCount);
+
+    function<void(int)> encodeBand = [&](int band) {
+        int firstRow = band * rowsPerBand;
+        int lastRow = min(height, firstRow + rowsPerBand);
+        vector<uint8_t> trial(stride);
+
+        for (int y = firstRow; y < lastRow; y++)
+        {
+            const uint8_t *row = rgb + (size_t)y * stride;
+            filterRow(row, y > 0 ? row - stride : NULL, stride, &filtered[(size_t)y * (stride + 1)], trial);
+        }
+
+        size_t begin = (size_t)firstRow * (stride + 1);
+        size_t end = (size_t)lastRow * (stride + 1);
+        deflateBand(&filtered[begin], end - begin, band == bandCount - 1, bands[band]);
+    };
+
+    if (pool != NULL)
+    {
+        pool->run(bandCount, encodeBand);
+    }
+    else
+    {
+        for (int band = 0; band < bandCount; band++)
+        {
+            encodeBand(band);
+        }
+    }
+
+    // zlib stream: header, concatenated bands, adler32 of the uncompressed data
+    vector<uint8_t> zlib;
+    zlib.push_back(0x78);
+    zlib.push_back(0x01);
+    for (int band = 0; band < bandCount; band++)
+    {
+        zlib.insert(zlib.end(), bands[band].bytes.begin(), bands[band].bytes.end());
+    }
+    putBigEndian(zlib, adler32(filtered.data(), filtered.size()));
+
+    vector<uint8_t> png;
+    const uint8_t signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    png.insert(png.end(), signature, signature + 8);
+
+    vector<uint8_t> header;
+    putBigEndian(header, width);
+    putBigEndian(header, height);
+    header.push_back(8); // bit depth
+    header.push_back(2); // truecolor
+    header.push_back(0); // deflate
+    header.push_back(0); // adaptive filtering
+    header.push_back(0); // no interlace
+    putChunk(png, "IHDR", header.data(), header.size());
+    putChunk(png, "IDAT", zlib.data(), zlib.size());
+    putChunk(png, "IEND", NULL, 0);
+
+    FILE *file = fopen(fileName.c_str(), "wb");
+    if (file == NULL)
+    {
+        return false;
+    }
+    bool ok = fwrite(png.data(), 1, png.size(), file) == png.size();
+    fclose(file);
+    if (ok && bytesWritten != NULL)
+    {
+        *bytesWritten = png.size();
+    }
+    return ok;
+}
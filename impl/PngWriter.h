@@ -0,0 +1,21 @@
+#ifndef __PNGWRITER_H__
+#define __PNGWRITER_H__
+
+#include <cstdint>
+#include <string>
+#include "ThreadPool.h"
+
+using namespace std;
+
+/*
+ * Minimal PNG encoder: 8 bit RGB, adaptive scanline filters and a built-in
+ * deflate (LZ77 + fixed Huffman codes). Horizontal bands of the image are
+ * compressed independently and in parallel, then joined into one zlib stream.
+ */
+class PngWriter
+{
+public:
+    static bool write(const string &fileName, int width, int height, const uint8_t *rgb, ThreadPool *pool, size_t *bytesWritten = NULL);
+};
+
+#endif
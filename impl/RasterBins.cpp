@@ -0,0 +1,97 @@
+#include "RasterBins.h"
+#include <cmath>
+#include <algorithm>
+
+using namespace std;
+
+RasterBins::RasterBins()
+{
+    this->width = 0;
+    this->height = 0;
+    this->tilesX = 0;
+    this->tilesY = 0;
+}
+
+/*
+ * Empty every bin and size the tile grid for a width x height image.
+ * Bin storage is kept between frames.
+ */
+void RasterBins::initialize(int width, int height)
+{
+    this->width = width;
+    this->height = height;
+    this->tilesX = (width + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+    this->tilesY = (height + RASTER_TILE_SIZE - 1) / RASTER_TILE_SIZE;
+
+    bins.resize(tilesX * tilesY);
+    clear();
+}
+
+/*
+ * Drop every binned primitive, keeping the tile grid.
+ */
+void RasterBins::clear()
+{
+    primitives.clear();
+    for (int i = 0; i < bins.size(); i++)
+    {
+        bins[i].clear();
+    }
+}
+
+void RasterBins::addLine(const ClipVertex &va, const ClipVertex &vb)
+{
+    Primitive p;
+    p.type = 0;
+    p.v[0] = va;
+    p.v[1] = vb;
+    primitives.push_back(p);
+
+    const Vec4 &a = va.position, &b = vb.position;
+    // one pixel of slack around the rounded end points
+    binPrimitive(primitives.size() - 1,
+                 min(round(a.x), round(b.x)) - 1, min(round(a.y), round(b.y)) - 1,
+                 max(round(a.x), round(b.x)) + 1, max(round(a.y), round(b.y)) + 1);
+}
+
+void RasterBins::addTriangle(const ClipVertex &va, const ClipVertex &vb, const ClipVertex &vc)
+{
+    Primitive p;
+    p.type = 1;
+    p.v[0] = va;
+    p.v[1] = vb;
+    p.v[2] = vc;
+    primitives.push_back(p);
+
+    const Vec4 &a = va.position, &b = vb.position, &c = vc.position;
+    binPrimitive(primitives.size() - 1,
+                 min(min(round(a.x), round(b.x)), round(c.x)), min(min(round(a.y), round(b.y)), round(c.y)),
+                 max(max(round(a.x), round(b.x)), round(c.x)), max(max(round(a.y), round(b.y)), round(c.y)));
+}
+
+/*
+ * Inclusive pixel rectangle owned by a tile.
+ */
+void RasterBins::getTileRect(int tile, int &minX, int &minY, int &maxX, int &maxY)
+{
+    minX = (tile % tilesX) * RASTER_TILE_SIZE;
+    minY = (tile / tilesX) * RASTER_TILE_SIZE;
+    maxX = min(minX + RASTER_TILE_SIZE, width) - 1;
+    maxY = min(minY + RASTER_TILE_SIZE, height) - 1;
+}
+
+void RasterBins::binPrimitive(int index, int minX, int minY, int maxX, int maxY)
+{
+    minX = max(minX, 0);
+    minY = max(minY, 0);
+    maxX = min(maxX, width - 1);
+    maxY = min(maxY, height - 1);
+
+    for (int ty = minY / RASTER_TILE_SIZE; ty <= maxY / RASTER_TILE_SIZE && minY <= maxY; ty++)
+    {
+        for (int tx = minX / RASTER_TILE_SIZE; tx <= maxX / RASTER_TILE_SIZE && minX <= maxX; tx++)
+        {
+            bins[tx + ty * tilesX].push_back(index);
+        }
+    }
+}
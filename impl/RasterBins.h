@@ -0,0 +1,38 @@
+#ifndef __RASTERBINS_H__
+#define __RASTERBINS_H__
+
+#include <vector>
+#include "ClipVertex.h"
+
+using namespace std;
+
+#define RASTER_TILE_SIZE 64
+
+class Primitive
+{
+public:
+    int type; // 0 for line, 1 for triangle
+    ClipVertex v[3];
+};
+
+class RasterBins
+{
+public:
+    int width, height;
+    int tilesX, tilesY;
+    vector<Primitive> primitives;  // viewport space, in submission order
+    vector< vector<int> > bins;    // primitive indices touching each tile
+
+    RasterBins();
+
+    void initialize(int width, int height);
+    void clear();
+    void addLine(const ClipVertex &a, const ClipVertex &b);
+    void addTriangle(const ClipVertex &a, const ClipVertex &b, const ClipVertex &c);
+    void getTileRect(int tile, int &minX, int &minY, int &maxX, int &maxY);
+
+private:
+    void binPrimitive(int index, int minX, int minY, int maxX, int maxY);
+};
+
+#endif
@@ -0,0 +1,310 @@
+#include "RasterKernel.h"
+#include <cmath>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#define RASTER_X86 1
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+/*
+ * Reference kernel, one pixel at a time. The vector kernels reproduce its
+ * arithmetic in the same order, so all of them give bit-identical images.
+ */
+int shadeSpanScalar(const SpanSetup &s, int y, int xLo, int xHi, int fA, int fB, int fC,
+                     double *depthRow, Framebuffer &image)
+{
+    Color colA = s.colA, colB = s.colB, colC = s.colC;
+    int written = 0;
+
+    for (int x = xLo; x <= xHi; x++, fA += s.stepA, fB += s.stepB, fC += s.stepC)
+    {
+        double alpha = (double)fA / s.area;
+        double beta = (double)fB / s.area;
+        double gamma = (double)fC / s.area;
+
+        double z = s.za * alpha + s.zb * beta + s.zc * gamma;
+        // later fragments win ties, like drawing order did
+        if (s.depthTest && z > depthRow[x])
+        {
+            continue;
+        }
+        if (s.depthWrite)
+        {
+            depthRow[x] = z;
+        }
+        written++;
+
+        Color col = colA * alpha + colB * beta + colC * gamma;
+        image.setPixel(x, y, Color(round(col.r), round(col.g), round(col.b)));
+    }
+
+    return written;
+}
+
+#ifdef RASTER_X86
+
+/*
+ * round() semantics (halfway cases away from zero) for two lanes.
+ */
+static inline __m128d roundHalfAway128(__m128d x)
+{
+    const __m128d signMask = _mm_set1_pd(-0.0);
+    // truncation through int32 is exact for color values, the sign keeps -0.0 intact
+    __m128d t = _mm_or_pd(_mm_cvtepi32_pd(_mm_cvttpd_epi32(x)), _mm_and_pd(x, signMask));
+    __m128d frac = _mm_andnot_pd(signMask, _mm_sub_pd(x, t));
+    __m128d away = _mm_cmpge_pd(frac, _mm_set1_pd(0.5));
+    __m128d one = _mm_or_pd(_mm_and_pd(x, signMask), _mm_set1_pd(1.0));
+    return _mm_or_pd(_mm_andnot_pd(away, t), _mm_and_pd(away, _mm_add_pd(t, one)));
+}
+
+/*
+ * Framebuffer::packRGBA8 for two lanes of whole numbers.
+ */
+static inline __m128i packRGBA8x2(__m128d r, __m128d g, __m128d b)
+{
+    const __m128d lo = _mm_setzero_pd(), hi = _mm_set1_pd(255.0);
+    __m128i ri = _mm_cvttpd_epi32(_mm_min_pd(_mm_max_pd(r, lo), hi));
+    __m128i gi = _mm_cvttpd_epi32(_mm_min_pd(_mm_max_pd(g, lo), hi));
+    __m128i bi = _mm_cvttpd_epi32(_mm_min_pd(_mm_max_pd(b, lo), hi));
+    __m128i packed = _mm_or_si128(ri, _mm_or_si128(_mm_slli_epi32(gi, 8), _mm_slli_epi32(bi, 16)));
+    return _mm_or_si128(packed, _mm_set1_epi32(0xFF000000));
+}
+
+/*
+ * Two pixels per iteration.
+ */
+int shadeSpanSSE2(const SpanSetup &s, int y, int xLo, int xHi, int fA, int fB, int fC,
+                   double *depthRow, Framebuffer &image)
+{
+    const __m128d area = _mm_set1_pd(s.area);
+    const __m128d za = _mm_set1_pd(s.za), zb = _mm_set1_pd(s.zb), zc = _mm_set1_pd(s.zc);
+    const __m128d ra = _mm_set1_pd(s.colA.r), rb = _mm_set1_pd(s.colB.r), rc = _mm_set1_pd(s.colC.r);
+    const __m128d ga = _mm_set1_pd(s.colA.g), gb = _mm_set1_pd(s.colB.g), gc = _mm_set1_pd(s.colC.g);
+    const __m128d ba = _mm_set1_pd(s.colA.b), bb = _mm_set1_pd(s.colB.b), bc = _mm_set1_pd(s.colC.b);
+
+    __m128i vA = _mm_setr_epi32(fA, fA + s.stepA, 0, 0);
+    __m128i vB = _mm_setr_epi32(fB, fB + s.stepB, 0, 0);
+    __m128i vC = _mm_setr_epi32(fC, fC + s.stepC, 0, 0);
+    const __m128i stepA = _mm_set1_epi32(2 * s.stepA);
+    const __m128i stepB = _mm_set1_epi32(2 * s.stepB);
+    const __m128i stepC = _mm_set1_epi32(2 * s.stepC);
+
+    int written = 0;
+
+    for (int x = xLo; x <= xHi; x += 2)
+    {
+        int lanes = xHi - x + 1 >= 2 ? 3 : 1;
+
+        __m128d alpha = _mm_div_pd(_mm_cvtepi32_pd(vA), area);
+        __m128d beta = _mm_div_pd(_mm_cvtepi32_pd(vB), area);
+        __m128d gamma = _mm_div_pd(_mm_cvtepi32_pd(vC), area);
+        vA = _mm_add_epi32(vA, stepA);
+        vB = _mm_add_epi32(vB, stepB);
+        vC = _mm_add_epi32(vC, stepC);
+
+        __m128d z = _mm_add_pd(_mm_add_pd(_mm_mul_pd(za, alpha), _mm_mul_pd(zb, beta)), _mm_mul_pd(zc, gamma));
+
+        if (s.depthTest)
+        {
+            __m128d stored = lanes == 3 ? _mm_loadu_pd(depthRow + x) : _mm_load_sd(depthRow + x);
+            lanes &= _mm_movemask_pd(_mm_cmpngt_pd(z, stored));
+            if (lanes == 0)
+            {
+                continue;
+            }
+        }
+        if (s.depthWrite)
+        {
+            if (lanes & 1)
+                _mm_storel_pd(depthRow + x, z);
+            if (lanes & 2)
+                _mm_storeh_pd(depthRow + x + 1, z);
+        }
+        written += __builtin_popcount(lanes);
+
+        __m128d r = roundHalfAway128(_mm_add_pd(_mm_add_pd(_mm_mul_pd(ra, alpha), _mm_mul_pd(rb, beta)), _mm_mul_pd(rc, gamma)));
+        __m128d g = roundHalfAway128(_mm_add_pd(_mm_add_pd(_mm_mul_pd(ga, alpha), _mm_mul_pd(gb, beta)), _mm_mul_pd(gc, gamma)));
+        __m128d b = roundHalfAway128(_mm_add_pd(_mm_add_pd(_mm_mul_pd(ba, alpha), _mm_mul_pd(bb, beta)), _mm_mul_pd(bc, gamma)));
+
+        if (image.format == FORMAT_RGBA8)
+        {
+            uint32_t packed[4];
+            _mm_storeu_si128((__m128i *)packed, packRGBA8x2(r, g, b));
+            uint32_t *row = image.rgba8Row(y);
+            if (lanes & 1)
+                row[x] = packed[0];
+            if (lanes & 2)
+                row[x + 1] = packed[1];
+        }
+        else
+        {
+            double rs[2], gs[2], bs[2];
+            _mm_storeu_pd(rs, r);
+            _mm_storeu_pd(gs, g);
+            _mm_storeu_pd(bs, b);
+            for (int k = 0; k < 2; k++)
+            {
+                if (lanes & (1 << k))
+                {
+                    image.setPixel(x + k, y, Color(rs[k], gs[k], bs[k]));
+                }
+            }
+        }
+    }
+
+    return written;
+}
+
+__attribute__((target("avx2")))
+static inline __m256d roundHalfAway256(__m256d x)
+{
+    const __m256d signMask = _mm256_set1_pd(-0.0);
+    __m256d t = _mm256_round_pd(x, _MM_FROUND_TO_ZERO | _MM_FROUND_NO_EXC);
+    __m256d frac = _mm256_andnot_pd(signMask, _mm256_sub_pd(x, t));
+    __m256d away = _mm256_cmp_pd(frac, _mm256_set1_pd(0.5), _CMP_GE_OQ);
+    __m256d one = _mm256_or_pd(_mm256_and_pd(x, signMask), _mm256_set1_pd(1.0));
+    return _mm256_blendv_pd(t, _mm256_add_pd(t, one), away);
+}
+
+/*
+ * Framebuffer::packRGBA8 for four lanes of whole numbers.
+ */
+__attribute__((target("avx2")))
+static inline __m128i packRGBA8x4(__m256d r, __m256d g, __m256d b)
+{
+    const __m256d lo = _mm256_setzero_pd(), hi = _mm256_set1_pd(255.0);
+    __m128i ri = _mm256_cvttpd_epi32(_mm256_min_pd(_mm256_max_pd(r, lo), hi));
+    __m128i gi = _mm256_cvttpd_epi32(_mm256_min_pd(_mm256_max_pd(g, lo), hi));
+    __m128i bi = _mm256_cvttpd_epi32(_mm256_min_pd(_mm256_max_pd(b, lo), hi));
+    __m128i packed = _mm_or_si128(ri, _mm_or_si128(_mm_slli_epi32(gi, 8), _mm_slli_epi32(bi, 16)));
+    return _mm_or_si128(packed, _mm_set1_epi32(0xFF000000));
+}
+
+/*
+ * Four pixels per iteration, depth and colors are stored with lane masks.
+ */
+__attribute__((target("avx2")))
+int shadeSpanAVX2(const SpanSetup &s, int y, int xLo, int xHi, int fA, int fB, int fC,
+                   double *depthRow, Framebuffer &image)
+{
+    const __m256d area = _mm256_set1_pd(s.area);
+    const __m256d za = _mm256_set1_pd(s.za), zb = _mm256_set1_pd(s.zb), zc = _mm256_set1_pd(s.zc);
+    const __m256d ra = _mm256_set1_pd(s.colA.r), rb = _mm256_set1_pd(s.colB.r), rc = _mm256_set1_pd(s.colC.r);
+    const __m256d ga = _mm256_set1_pd(s.colA.g), gb = _mm256_set1_pd(s.colB.g), gc = _mm256_set1_pd(s.colC.g);
+    const __m256d ba = _mm256_set1_pd(s.colA.b), bb = _mm256_set1_pd(s.colB.b), bc = _mm256_set1_pd(s.colC.b);
+
+    __m128i vA = _mm_add_epi32(_mm_set1_epi32(fA), _mm_setr_epi32(0, s.stepA, 2 * s.stepA, 3 * s.stepA));
+    __m128i vB = _mm_add_epi32(_mm_set1_epi32(fB), _mm_setr_epi32(0, s.stepB, 2 * s.stepB, 3 * s.stepB));
+    __m128i vC = _mm_add_epi32(_mm_set1_epi32(fC), _mm_setr_epi32(0, s.stepC, 2 * s.stepC, 3 * s.stepC));
+    const __m128i stepA = _mm_set1_epi32(4 * s.stepA);
+    const __m128i stepB = _mm_set1_epi32(4 * s.stepB);
+    const __m128i stepC = _mm_set1_epi32(4 * s.stepC);
+    const __m256i laneIndex = _mm256_setr_epi64x(0, 1, 2, 3);
+
+    int written = 0;
+
+    for (int x = xLo; x <= xHi; x += 4)
+    {
+        __m256i inSpan = _mm256_cmpgt_epi64(_mm256_set1_epi64x(xHi - x + 1), laneIndex);
+
+        __m256d alpha = _mm256_div_pd(_mm256_cvtepi32_pd(vA), area);
+        __m256d beta = _mm256_div_pd(_mm256_cvtepi32_pd(vB), area);
+        __m256d gamma = _mm256_div_pd(_mm256_cvtepi32_pd(vC), area);
+        vA = _mm_add_epi32(vA, stepA);
+        vB = _mm_add_epi32(vB, stepB);
+        vC = _mm_add_epi32(vC, stepC);
+
+        __m256d z = _mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(za, alpha), _mm256_mul_pd(zb, beta)), _mm256_mul_pd(zc, gamma));
+
+        __m256d pass = _mm256_castsi256_pd(inSpan);
+        if (s.depthTest)
+        {
+            __m256d stored = _mm256_maskload_pd(depthRow + x, inSpan);
+            pass = _mm256_and_pd(pass, _mm256_cmp_pd(z, stored, _CMP_NGT_UQ));
+        }
+        int lanes = _mm256_movemask_pd(pass);
+        if (lanes == 0)
+        {
+            continue;
+        }
+        if (s.depthWrite)
+        {
+            _mm256_maskstore_pd(depthRow + x, _mm256_castpd_si256(pass), z);
+        }
+        written += __builtin_popcount(lanes);
+
+        __m256d r = roundHalfAway256(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(ra, alpha), _mm256_mul_pd(rb, beta)), _mm256_mul_pd(rc, gamma)));
+        __m256d g = roundHalfAway256(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(ga, alpha), _mm256_mul_pd(gb, beta)), _mm256_mul_pd(gc, gamma)));
+        __m256d b = roundHalfAway256(_mm256_add_pd(_mm256_add_pd(_mm256_mul_pd(ba, alpha), _mm256_mul_pd(bb, beta)), _mm256_mul_pd(bc, gamma)));
+
+        if (image.format == FORMAT_RGBA8)
+        {
+            __m128i mask = _mm_cmpgt_epi32(_mm_and_si128(_mm_set1_epi32(lanes), _mm_setr_epi32(1, 2, 4, 8)), _mm_setzero_si128());
+            _mm_maskstore_epi32((int *)(image.rgba8Row(y) + x), mask, packRGBA8x4(r, g, b));
+        }
+        else
+        {
+            double rs[4], gs[4], bs[4];
+            _mm256_storeu_pd(rs, r);
+            _mm256_storeu_pd(gs, g);
+            _mm256_storeu_pd(bs, b);
+            for (int k = 0; k < 4; k++)
+            {
+                if (lanes & (1 << k))
+                {
+                    image.setPixel(x + k, y, Color(rs[k], gs[k], bs[k]));
+                }
+            }
+        }
+    }
+
+    return written;
+}
+
+#else
+
+int shadeSpanSSE2(const SpanSetup &s, int y, int xLo, int xHi, int fA, int fB, int fC,
+                   double *depthRow, Framebuffer &image)
+{
+    return shadeSpanScalar(s, y, xLo, xHi, fA, fB, fC, depthRow, image);
+}
+
+int shadeSpanAVX2(const SpanSetup &s, int y, int xLo, int xHi, int fA, int fB, int fC,
+                   double *depthRow, Framebuffer &image)
+{
+    return shadeSpanScalar(s, y, xLo, xHi, fA, fB, fC, depthRow, image);
+}
+
+#endif
+
+int detectIsa()
+{
+#ifdef RASTER_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2"))
+    {
+        return ISA_AVX2;
+    }
+    if (__builtin_cpu_supports("sse2"))
+    {
+        return ISA_SSE2;
+    }
+#endif
+    return ISA_SCALAR;
+}
+
+SpanKernel selectSpanKernel(int maxIsa)
+{
+    switch (min(maxIsa, detectIsa()))
+    {
+    case ISA_AVX2:
+        return shadeSpanAVX2;
+    case ISA_SSE2:
+        return shadeSpanSSE2;
+    default:
+        return shadeSpanScalar;
+    }
+}
@@ -0,0 +1,50 @@
+#ifndef __RASTERKERNEL_H__
+#define __RASTERKERNEL_H__
+
+#include "Color.h"
+#include "Framebuffer.h"
+
+#define ISA_SCALAR 0
+#define ISA_SSE2 1
+#define ISA_AVX2 2
+
+/*
+ * Per triangle constants shared by every span of the triangle.
+ */
+class SpanSetup
+{
+public:
+    double area;               // twice the signed area, denominator of the barycentrics
+    int stepA, stepB, stepC;   // edge function increments along x
+    double za, zb, zc;
+    Color colA, colB, colC;
+    bool depthTest;            // false: every covered pixel passes
+    bool depthWrite;
+};
+
+/*
+ * Shades pixels xLo..xHi of row y, which must all be covered by the triangle.
+ * fA, fB, fC are the edge function values at (xLo, y).
+ * Returns how many pixels passed the depth test and were written.
+ */
+typedef int (*SpanKernel)(const SpanSetup &s, int y, int xLo, int xHi, int fA, int fB, int fC,
+                           double *depthRow, Framebuffer &image);
+
+int shadeSpanScalar(const SpanSetup &s, int y, int xLo, int xHi, int fA, int fB, int fC,
+                     double *depthRow, Framebuffer &image);
+int shadeSpanSSE2(const SpanSetup &s, int y, int xLo, int xHi, int fA, int fB, int fC,
+                   double *depthRow, Framebuffer &image);
+int shadeSpanAVX2(const SpanSetup &s, int y, int xLo, int xHi, int fA, int fB, int fC,
+                   double *depthRow, Framebuffer &image);
+
+/*
+ * Widest instruction set supported by this CPU.
+ */
+int detectIsa();
+
+/*
+ * Picks the widest kernel the CPU supports, but no wider than maxIsa.
+ */
+SpanKernel selectSpanKernel(int maxIsa);
+
+#endif
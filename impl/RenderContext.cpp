@@ -0,0 +1,11 @@
+#include "RenderContext.h"
+
+RenderContext::RenderContext()
+{
+    this->camera = NULL;
+    this->spanKernel = NULL;
+    this->tilePool = NULL;
+    this->pyramidFinal = false;
+    this->pyramidWidth = 0;
+    this->pyramidHeight = 0;
+}
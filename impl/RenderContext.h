@@ -0,0 +1,71 @@
+#ifndef __RENDERCONTEXT_H__
+#define __RENDERCONTEXT_H__
+
+#include <vector>
+#include "AttributePool.h"
+#include "Camera.h"
+#include "DepthBuffer.h"
+#include "Framebuffer.h"
+#include "HiZPyramid.h"
+#include "Matrix4.h"
+#include "Mesh.h"
+#include "RasterBins.h"
+#include "RasterKernel.h"
+#include "RenderStats.h"
+#include "ThreadPool.h"
+#include "Vec4.h"
+#include "Vec4Array.h"
+
+using namespace std;
+
+/*
+ * Everything one camera's render writes to. The Scene is only read while
+ * rendering, so cameras with separate contexts can render at the same time.
+ */
+class RenderContext
+{
+public:
+    Camera *camera;
+    Framebuffer image;
+    DepthBuffer depthBuffer;
+    RasterBins bins;
+    SpanKernel spanKernel;
+    ThreadPool *tilePool; // rasterizes tiles in parallel, NULL for the calling thread only
+
+    // vertex transform cache in homogeneous clip coordinates, indexed like Scene::vertexData
+    Vec4Array clipVertices;
+    vector<int> clipOutcodes;
+    double clipPlanes[6][4]; // see clipSpacePlanes
+
+    // gather buffers for meshes whose vertices are not consecutive
+    Vec4Array meshVertices, meshClip;
+
+    // per frame scratch, reset by Scene::forwardRenderingPipeline
+    AttributePool clipColors;
+    vector<Vec4> linePoints;
+    vector<uint8_t> triangleVisibility; // BOUNDS_* per triangle of the current mesh, from its Bvh
+    vector<uint8_t> backfacing; // per triangle of the current mesh, see backfacingTriangles
+
+    // occlusion culling depth, final when the last camera finished with it
+    HiZPyramid pyramid;
+    bool pyramidFinal;
+    Matrix4 pyramidMatrix; // camera matrix the final pyramid was drawn with
+    int pyramidWidth, pyramidHeight;
+
+    // front-to-back draw order, kept for later cameras at the same position and direction
+    vector<Mesh *> drawOrder;
+    vector< pair<double, int> > sortKeys;
+    Vec3 drawOrderPos, drawOrderW;
+
+    // counters of the current camera, and of each tile while rasterizing
+    RenderStats stats;
+    vector<RenderStats> tileStats;
+
+    RenderContext();
+
+private:
+    RenderContext(const RenderContext &other);
+    RenderContext &operator=(const RenderContext &other);
+};
+
+#endif
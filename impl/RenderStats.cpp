@@ -0,0 +1,123 @@
+#include "RenderStats.h"
+#include <cstdio>
+#include <iomanip>
+
+RenderStats::RenderStats()
+{
+    reset();
+}
+
+void RenderStats::reset()
+{
+    meshesCulled = meshesUnclipped = meshesOccluded = 0;
+    trianglesIn = trianglesRejected = trianglesCulled = trianglesClipped = 0;
+    trianglesEmitted = linesEmitted = 0;
+    fragmentsTested = fragmentsWritten = bytesWritten = 0;
+    wallTime = geometryTime = clipTime = rasterTime = triangleTime = lineTime = writeTime = 0;
+}
+
+void RenderStats::add(const RenderStats &other)
+{
+    meshesCulled += other.meshesCulled;
+    meshesUnclipped += other.meshesUnclipped;
+    meshesOccluded += other.meshesOccluded;
+    trianglesIn += other.trianglesIn;
+    trianglesRejected += other.trianglesRejected;
+    trianglesCulled += other.trianglesCulled;
+    trianglesClipped += other.trianglesClipped;
+    trianglesEmitted += other.trianglesEmitted;
+    linesEmitted += other.linesEmitted;
+    fragmentsTested += other.fragmentsTested;
+    fragmentsWritten += other.fragmentsWritten;
+    bytesWritten += other.bytesWritten;
+
+    wallTime += other.wallTime;
+    geometryTime += other.geometryTime;
+    clipTime += other.clipTime;
+    rasterTime += other.rasterTime;
+    triangleTime += other.triangleTime;
+    lineTime += other.lineTime;
+    writeTime += other.writeTime;
+}
+
+static void writeMilliseconds(ostream &os, const string &indent, const char *name, uint64_t nanoseconds, bool last = false)
+{
+    os << indent << "\"" << name << "\": " << fixed << setprecision(3) << nanoseconds / 1e6 << (last ? "\n" : ",\n");
+}
+
+static void writeCount(ostream &os, const string &indent, const char *name, uint64_t value)
+{
+    os << indent << "\"" << name << "\": " << value << ",\n";
+}
+
+void RenderStats::writeJsonFields(ostream &os, const string &indent) const
+{
+    writeCount(os, indent, "meshesCulled", meshesCulled);
+    writeCount(os, indent, "meshesUnclipped", meshesUnclipped);
+    writeCount(os, indent, "meshesOccluded", meshesOccluded);
+    writeCount(os, indent, "trianglesIn", trianglesIn);
+    writeCount(os, indent, "trianglesRejected", trianglesRejected);
+    writeCount(os, indent, "trianglesCulled", trianglesCulled);
+    writeCount(os, indent, "trianglesClipped", trianglesClipped);
+    writeCount(os, indent, "trianglesEmitted", trianglesEmitted);
+    writeCount(os, indent, "linesEmitted", linesEmitted);
+    writeCount(os, indent, "fragmentsTested", fragmentsTested);
+    writeCount(os, indent, "fragmentsWritten", fragmentsWritten);
+    writeCount(os, indent, "bytesWritten", bytesWritten);
+
+    writeMilliseconds(os, indent, "wallMs", wallTime);
+    writeMilliseconds(os, indent, "geometryMs", geometryTime);
+    writeMilliseconds(os, indent, "clipMs", clipTime);
+    writeMilliseconds(os, indent, "rasterMs", rasterTime);
+    writeMilliseconds(os, indent, "triangleMs", triangleTime);
+    writeMilliseconds(os, indent, "lineMs", lineTime);
+    writeMilliseconds(os, indent, "writeMs", writeTime, true);
+}
+
+void writeJsonString(ostream &os, const string &s)
+{
+    os << '"';
+    for (char c : s)
+    {
+        if (c == '"' || c == '\\')
+        {
+            os << '\\' << c;
+        }
+        else if ((unsigned char)c < 0x20)
+        {
+            char escaped[8];
+            snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+            os << escaped;
+        }
+        else
+        {
+            os << c;
+        }
+    }
+    os << '"';
+}
+
+ScopedTimer::ScopedTimer(uint64_t &target) : target(target)
+{
+    start = now();
+    running = true;
+}
+
+ScopedTimer::~ScopedTimer()
+{
+    stop();
+}
+
+void ScopedTimer::stop()
+{
+    if (running)
+    {
+        target += now() - start;
+        running = false;
+    }
+}
+
+uint64_t ScopedTimer::now()
+{
+    return chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now().time_since_epoch()).count();
+}
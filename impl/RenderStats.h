@@ -0,0 +1,97 @@
+#ifndef __RENDERSTATS_H__
+#define __RENDERSTATS_H__
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+#include <string>
+
+using namespace std;
+
+// build with -DRENDER_STATS=0 to compile every counter and timer out
+#ifndef RENDER_STATS
+#define RENDER_STATS 1
+#endif
+
+/*
+ * Counters and stage times of one camera's render. Times are nanoseconds;
+ * stages that run on several threads sum the time of every thread.
+ */
+class RenderStats
+{
+public:
+    uint64_t meshesCulled;      // bounding volume outside the view volume
+    uint64_t meshesUnclipped;   // bounding volume inside the view volume
+    uint64_t meshesOccluded;    // bounding box behind the depth drawn before it
+    uint64_t trianglesIn;       // triangles of every mesh
+    uint64_t trianglesRejected; // every corner outside the same clip plane, culled meshes included
+    uint64_t trianglesCulled;   // backfacing
+    uint64_t trianglesClipped;  // crossed a clip plane and were clipped
+    uint64_t trianglesEmitted;  // binned for rasterization, after clipping
+    uint64_t linesEmitted;
+    uint64_t fragmentsTested;   // covered pixels
+    uint64_t fragmentsWritten;  // covered pixels that passed the depth test
+    uint64_t bytesWritten;      // image files
+
+    uint64_t wallTime;
+    uint64_t geometryTime; // transform, cull, clip and bin
+    uint64_t clipTime;
+    uint64_t rasterTime;
+    uint64_t triangleTime; // inside rasterizeTriangle
+    uint64_t lineTime;     // inside rasterizeLine
+    uint64_t writeTime;
+
+    RenderStats();
+
+    void reset();
+    void add(const RenderStats &other);
+
+    /*
+     * Writes the fields as members of a JSON object, without the braces.
+     */
+    void writeJsonFields(ostream &os, const string &indent) const;
+};
+
+/*
+ * Writes s as a quoted JSON string.
+ */
+void writeJsonString(ostream &os, const string &s);
+
+/*
+ * Adds the lifetime of the timer to a nanosecond counter,
+ * or the time until stop when that is called first.
+ */
+class ScopedTimer
+{
+public:
+    ScopedTimer(uint64_t &target);
+    ~ScopedTimer();
+
+    void stop();
+
+    static uint64_t now();
+
+private:
+    uint64_t &target;
+    uint64_t start;
+    bool running;
+};
+
+#define STATS_CONCAT2(a, b) a##b
+#define STATS_CONCAT(a, b) STATS_CONCAT2(a, b)
+
+#if RENDER_STATS
+#define STATS_ADD(stats, counter, n) ((stats).counter += (n))
+#define STATS_TIMER(stats, timer) ScopedTimer STATS_CONCAT(statsTimer, __LINE__)((stats).timer)
+#define STATS_TIMER_NAMED(name, stats, timer) ScopedTimer name((stats).timer)
+#define STATS_STOP(name) name.stop()
+#else
+// no-ops: stats is only named and n is never evaluated, so parameters and locals
+// that just feed the macros stay used without running anything
+#define STATS_ADD(stats, counter, n) ((void)(stats), (void)sizeof(n))
+#define STATS_TIMER(stats, timer) ((void)(stats))
+#define STATS_TIMER_NAMED(name, stats, timer) ((void)(stats))
+#define STATS_STOP(name) ((void)0)
+#endif
+
+#endif
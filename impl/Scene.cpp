@@ -4,6 +4,7 @@
 #include <cstring>
 #include <fstream>
 #include <cmath>
+#include <algorithm>
 
 #include "Scene.h"
 #include "Camera.h"
@@ -14,182 +15,611 @@
 #include "Translation.h"
 #include "Triangle.h"
 #include "Vec3.h"
-#include "tinyxml2.h"
 #include "Helpers.h"
+#include "PngWriter.h"
+#include "SceneCache.h"
+#include "SceneLoader.h"
 
-using namespace tinyxml2;
 using namespace std;
 
 /*
 	Transformations, clipping, culling, rasterization are done here.
 	You may define helper functions.
 */
-void Scene::forwardRenderingPipeline(Camera *camera)
+void Scene::forwardRenderingPipeline(Camera *camera, RenderContext &context) const
 {
-	//viewport transformation
+	STATS_TIMER_NAMED(geometryTimer, context.stats, geometryTime);
+
+	//viewport transformation, applied after the perspective divide
 	int nx = camera->horRes, ny = camera->verRes;
-	double vpVal[4][4] = {{nx/2.0,0,0,(nx-1)/2.0},{0,ny/2.0,0,(ny-1)/2.0},{0,0,1/2.0,1/2.0},{0,0,0,0}};
+	double vpVal[4][4] = {{nx/2.0,0,0,(nx-1)/2.0},{0,ny/2.0,0,(ny-1)/2.0},{0,0,1/2.0,1/2.0},{0,0,0,1}};
 	Matrix4 Mvp(vpVal);
+	const Matrix4 &VP = camera->getMatrix();
+	clipSpacePlanes(context.clipPlanes);
+
+	context.clipVertices.resize(vertexData.size());
+	context.clipOutcodes.resize(vertexData.size());
+	context.bins.initialize(nx, ny);
+	context.clipColors.reset(vertexData.size()+1);
+	context.camera = camera;
+	context.spanKernel = selectSpanKernel(rasterIsa);
+
+	//occlusion culling tests solids against the depth drawn so far, or against the final depth
+	//of the context's previous camera when that saw the scene through the very same matrix
+	bool occlusion = occlusionCullingEnabled && depthTestEnabled;
+	bool reusePyramid = occlusion && context.pyramidFinal && context.pyramidWidth == nx && context.pyramidHeight == ny &&
+		memcmp(context.pyramidMatrix.val, VP.val, sizeof(VP.val)) == 0;
+	if(!reusePyramid){
+		context.pyramid.clear();
+	}
+	context.pyramidFinal = false;
+#if RENDER_STATS
+	uint64_t rasterTimeBefore = context.stats.rasterTime;
+#endif
+
+	for(auto m: meshDrawOrder(camera, context)){
+		int drawingMode = m->type;
+
+		//model transformations, composed once at load time
+		const Matrix4 &T = transformCache.getMatrix(m->transformNode);
+
+		//one composed matrix per mesh
+		Matrix4 MVP = multiplyMatrixWithMatrix(VP, T);
+		Span<const uint32_t> indices = m->getIndices();
+		STATS_ADD(context.stats, trianglesIn, indices.size()/3);
+
+		//frustum test of the bounding volume, with the clip planes pulled back to object space
+		double objectPlanes[6][4];
+		transformClipPlanes(context.clipPlanes, MVP, objectPlanes);
+		int visibility = m->bounds.classify(objectPlanes);
+		if(visibility == BOUNDS_OUTSIDE){
+			STATS_ADD(context.stats, meshesCulled, 1);
+			STATS_ADD(context.stats, trianglesRejected, indices.size()/3);
+			continue;
+		}
+		//hidden behind what is drawn already
+		if(occlusion && drawingMode==1 && isMeshOccluded(context, m, multiplyMatrixWithMatrix(Mvp, MVP), reusePyramid)){
+			STATS_ADD(context.stats, meshesOccluded, 1);
+			STATS_ADD(context.stats, trianglesRejected, indices.size()/3);
+			continue;
+		}
 
+		//every vertex is inside, outcodes would all be 0
+		bool unclipped = visibility == BOUNDS_INSIDE;
+		STATS_ADD(context.stats, meshesUnclipped, unclipped);
 
-	for(auto m: meshes){
-		drawingMode = m->type;
+		//the same test per Bvh node, for meshes only partly in view
+		const uint8_t *triangleVisibility = NULL;
+		if(!unclipped && bvhEnabled && !m->bvh.isEmpty()){
+			context.triangleVisibility.assign(indices.size()/3, BOUNDS_OUTSIDE);
+			m->bvh.classify(objectPlanes, context.triangleVisibility.data());
+			triangleVisibility = context.triangleVisibility.data();
+		}
 
-		Matrix4 T(getIdentityMatrix());
+		transformVertices(context, m, MVP, !unclipped);
 
-		//model transformations
-		for(int i=0;i<(m->numberOfTransformations);i++){
-			int id=m->transformationIds[i]-1;
-			char type=m->transformationTypes[i];
-			if(type=='r'){
-				T = multiplyMatrixWithMatrix(rotations[id]->getMatrix(),T);
-			}else if(type == 't'){
-				T = multiplyMatrixWithMatrix(translations[id]->getMatrix(),T);
-			}else if(type == 's'){
-				T = multiplyMatrixWithMatrix(scalings[id]->getMatrix(),T);
-			}else{
-				cerr<<"something went wrong."<<endl;
-			}
+		//backface culling of the whole mesh at once, from the transformed corners
+		const uint8_t *backfacing = NULL;
+		if(cullingEnabled){
+			double *clip[4];
+			context.clipVertices.getPointers(clip, 0);
+			context.backfacing.resize(indices.size()/3);
+			backfacingTriangles(clip, indices.data, indices.size()/3, context.backfacing.data());
+			backfacing = context.backfacing.data();
 		}
+		for(size_t i=0;i+2<indices.size();i+=3){
+			uint32_t ia = indices[i], ib = indices[i+1], ic = indices[i+2];
 
-		for(auto t: m->triangles){
-			Vec4 a = Vec4::convertFromVec3(*vertices[t.vertexIds[0]-1]);
-			Vec4 b = Vec4::convertFromVec3(*vertices[t.vertexIds[1]-1]);
-			Vec4 c = Vec4::convertFromVec3(*vertices[t.vertexIds[2]-1]);
-
-			//save world coordinates
-			Vec4 aW = multiplyMatrixWithVec4(T, a);
-			Vec4 bW = multiplyMatrixWithVec4(T, b);
-			Vec4 cW = multiplyMatrixWithVec4(T, c);
+			bool triangleUnclipped = unclipped;
+			if(triangleVisibility){
+				if(triangleVisibility[i/3] == BOUNDS_OUTSIDE){
+					STATS_ADD(context.stats, trianglesRejected, 1);
+					continue;
+				}
+				triangleUnclipped = triangleVisibility[i/3] == BOUNDS_INSIDE;
+			}
 
 			// world to camera transformation +
 			// camera to view (cvv) transformation (inverts coordinate system)
-			a = multiplyMatrixWithVec4(camera->getMatrix(),aW);
-			b = multiplyMatrixWithVec4(camera->getMatrix(),bW);
-			c = multiplyMatrixWithVec4(camera->getMatrix(),cW);
-
-			//backface culling
-			if(cullingEnabled){
-				Vec3 a3(aW.x,aW.y,aW.z,-1);
-				Vec3 b3(bW.x,bW.y,bW.z,-1);
-				Vec3 c3(cW.x,cW.y,cW.z,-1);
-
-				//unit normal vector of the triangle
-				Vec3 n = normalizeVec3(crossProductVec3(subtractVec3(b3,a3),subtractVec3(c3,a3)));
-
-				//unit looking direction (to the object)
-				Vec3 eyeDir;
-				if(camera->projectionType==0){
-					//ortho
-					eyeDir = normalizeVec3(camera->w);
-				}else{
-					//perspective
-					eyeDir = normalizeVec3(subtractVec3(camera->pos,a3));
-				}
-
-				//skip the object if it is facing away
-				if(dotProductVec3(n,eyeDir)<0){
-					continue;
-				}
+			Vec4 a = context.clipVertices.get(ia,ia+1);
+			Vec4 b = context.clipVertices.get(ib,ib+1);
+			Vec4 c = context.clipVertices.get(ic,ic+1);
+
+			//trivial reject, every corner is outside the same clip plane
+			int outA = triangleUnclipped ? 0 : context.clipOutcodes[ia];
+			int outB = triangleUnclipped ? 0 : context.clipOutcodes[ib];
+			int outC = triangleUnclipped ? 0 : context.clipOutcodes[ic];
+			if(outA & outB & outC){
+				STATS_ADD(context.stats, trianglesRejected, 1);
+				continue;
 			}
 
-			//perspective division
-			if(camera->projectionType == 1){
-				//! what about a.t = 0?
-				a.applyPerspectiveDivision();
-				b.applyPerspectiveDivision();
-				c.applyPerspectiveDivision();
+			//skip the triangle if it is facing away
+			if(backfacing && backfacing[i/3]){
+				STATS_ADD(context.stats, trianglesCulled, 1);
+				continue;
+			}
+			if(outA | outB | outC){
+				STATS_ADD(context.stats, trianglesClipped, 1);
 			}
-			//clipping
-			vector<Vec4> points;
+
+			//clipping, in homogeneous clip space against clipPlanes
 
 			//wireframe
 			if(drawingMode==0){
-				clipLine(a,b,points);
-				clipLine(b,c,points);
-				clipLine(c,a,points);
+				vector<Vec4> &points = context.linePoints;
+				points.clear();
+				clipLine(context, a,b,outA,outB,points);
+				clipLine(context, b,c,outB,outC,points);
+				clipLine(context, c,a,outC,outA,points);
+
+				for(auto &k:points){
+					//perspective division, only surviving vertices get here so w > 0
+					k.applyPerspectiveDivision();
+					k = multiplyMatrixWithVec4(Mvp, k);
+				}
+
+				//binning, rasterization happens once every mesh is binned
+				for(int i=0;i<(int)points.size()-1;i+=2){
+					context.bins.addLine(ClipVertex(points[i],indexColor(context, points[i].colorId)),ClipVertex(points[i+1],indexColor(context, points[i+1].colorId)));
+				}
+				STATS_ADD(context.stats, linesEmitted, points.size()/2);
 			}
 
 			//solid
 			if(drawingMode==1){
-				clipTriangle(a,b,c,points);
-			}
+				ClipVertex polygon[MAX_CLIP_VERTICES];
+				int count = 3;
+				polygon[0] = ClipVertex(a,indexColor(context, a.colorId));
+				polygon[1] = ClipVertex(b,indexColor(context, b.colorId));
+				polygon[2] = ClipVertex(c,indexColor(context, c.colorId));
+
+				//clip unless trivially accepted
+				if(outA | outB | outC){
+					STATS_TIMER(context.stats, clipTime);
+					count = clipTriangle(context, polygon,outA | outB | outC);
+				}
 
-			for(auto &k:points){
-				//viewport transformation
-				k = multiplyMatrixWithVec4(Mvp, k);
+				for(int k=0;k<count;k++){
+					//perspective division, only surviving vertices get here so w > 0
+					polygon[k].position.applyPerspectiveDivision();
+					polygon[k].position = multiplyMatrixWithVec4(Mvp, polygon[k].position);
+				}
+
+				//binning as a triangle fan, rasterization happens once every mesh is binned
+				for(int i=1;i<count-1;i++){
+					context.bins.addTriangle(polygon[0],polygon[i],polygon[i+1]);
+				}
+				STATS_ADD(context.stats, trianglesEmitted, max(count-2, 0));
 			}
+		}
+	}
+	STATS_STOP(geometryTimer);
+#if RENDER_STATS
+	//bins flushed for occlusion tests count as raster time only
+	context.stats.geometryTime -= context.stats.rasterTime - rasterTimeBefore;
+#endif
+
+	rasterizeBins(context);
+
+	if(occlusion){
+		context.pyramid.build(context.depthBuffer);
+		context.pyramidFinal = true;
+		context.pyramidMatrix = VP;
+		context.pyramidWidth = nx;
+		context.pyramidHeight = ny;
+	}
+}
 
-			//rasterization
+/*
+	The order meshes are drawn in. Front-to-back mode draws solids by the view depth of the
+	nearest point of their world space sphere, then the wireframes in input order, as lines
+	are not depth tested. Meshes at equal depth may still overlap, so the image can differ
+	where coplanar solids overlap. The order only depends on the camera position and w and
+	is kept for the context's next camera when those are the same.
+*/
+const vector<Mesh*> &Scene::meshDrawOrder(Camera *camera, RenderContext &context) const
+{
+	//without the depth test the order decides what is visible
+	if(!frontToBackEnabled || !depthTestEnabled){
+		return meshes;
+	}
+	Vec3 pos = camera->pos, w = camera->w;
+	if(context.drawOrder.size()==meshes.size() && pos.x==context.drawOrderPos.x && pos.y==context.drawOrderPos.y && pos.z==context.drawOrderPos.z &&
+		w.x==context.drawOrderW.x && w.y==context.drawOrderW.y && w.z==context.drawOrderW.z){
+		return context.drawOrder;
+	}
 
-			//wireframe
-			if(drawingMode==0){
-				for(int i=0;i<(int)points.size()-1;i+=2){
-					rasterizeLine(points[i],points[i+1]);
-				}
+	//the camera looks down -w
+	double length = sqrt(w.x*w.x + w.y*w.y + w.z*w.z);
+	double gaze[3] = {-w.x/length, -w.y/length, -w.z/length};
+	context.sortKeys.clear();
+	for(size_t i=0;i<meshes.size();i++){
+		const Mesh *m = meshes[i];
+		if(m->type!=1){
+			continue;
+		}
+		double depth = HUGE_VAL;
+		if(m->sortRadius>=0){
+			depth = gaze[0]*(m->sortCenter[0]-pos.x) + gaze[1]*(m->sortCenter[1]-pos.y) + gaze[2]*(m->sortCenter[2]-pos.z) - m->sortRadius;
+		}
+		context.sortKeys.push_back(make_pair(depth, (int)i));
+	}
+	//ties keep input order
+	sort(context.sortKeys.begin(), context.sortKeys.end());
+
+	context.drawOrder.clear();
+	for(auto &key: context.sortKeys){
+		context.drawOrder.push_back(meshes[key.second]);
+	}
+	for(auto m: meshes){
+		if(m->type!=1){
+			context.drawOrder.push_back(m);
+		}
+	}
+	context.drawOrderPos = pos;
+	context.drawOrderW = w;
+	return context.drawOrder;
+}
+
+/*
+	Whether the bounding box of mesh, drawn through modelToScreen, is entirely behind the depth in
+	context.pyramid. Unless the pyramid is reused from a previous camera, what is binned
+	so far is rasterized first and the pyramid is rebuilt from the depth buffer.
+*/
+bool Scene::isMeshOccluded(RenderContext &context, const Mesh *mesh, const Matrix4 &modelToScreen, bool reusePyramid) const
+{
+	double minX, minY, maxX, maxY, minZ;
+	if(!mesh->bounds.project(modelToScreen, minX, minY, maxX, maxY, minZ)){
+		return false;
+	}
+
+	if(!reusePyramid){
+		if(!context.bins.primitives.empty()){
+			rasterizeBins(context);
+			context.bins.clear();
+			context.pyramid.clear();
+		}
+		if(context.pyramid.isEmpty()){
+			context.pyramid.build(context.depthBuffer);
+		}
+	}
+
+	//a pixel of slack for the rounded corners, and some depth for rounding in the divide
+	minZ -= OCCLUSION_DEPTH_EPSILON * (fabs(minZ) + 1);
+	return context.pyramid.isOccluded(floor(minX)-1, floor(minY)-1, ceil(maxX)+1, ceil(maxY)+1, minZ);
+}
+
+/*
+	Renders every camera and writes its images. With several cameras and threads,
+	the cameras are split into one run of consecutive cameras per thread. Each run
+	renders serially into one context with its tiles walked serially, so the context
+	carries over from one camera to the next, like with a single thread. A single
+	camera, or a single thread, uses the pool for tiles instead.
+*/
+void Scene::renderCameras(bool writePPM, bool writePNG)
+{
+	if(bvhEnabled){
+		buildMeshBvhs();
+	}
+
+	//camera matrices are computed lazily, settle them before cameras are shared between threads
+	for(auto c: cameras){
+		c->getMatrix();
+	}
+
+	cameraStats.assign(cameras.size(), RenderStats());
+
+	ThreadPool *pool = getRasterPool();
+	if(cameras.size() > 1 && pool->size() > 1){
+		int runs = min((int)cameras.size(), pool->size());
+		pool->run(runs, [this, runs, writePPM, writePNG](int run){
+			RenderContext context;
+			size_t first = run*cameras.size()/runs, last = (run+1)*cameras.size()/runs;
+			for(size_t i=first;i<last;i++){
+				renderCamera(cameras[i], context, writePPM, writePNG);
+				cameraStats[i] = context.stats;
 			}
+		});
+		return;
+	}
 
-			//solid
-			if(drawingMode==1){
-				for(int i=0;i<(int)points.size()-2;i+=3){
-					rasterizeTriangle(points[i],points[i+1],points[i+2]);
+	RenderContext context;
+	context.tilePool = pool;
+	for(size_t i=0;i<cameras.size();i++){
+		renderCamera(cameras[i], context, writePPM, writePNG);
+		cameraStats[i] = context.stats;
+	}
+}
+
+/*
+	Renders one camera into context and writes its image files.
+	context.stats holds the counters and times of this camera afterwards.
+*/
+void Scene::renderCamera(Camera *camera, RenderContext &context, bool writePPM, bool writePNG) const
+{
+	context.stats.reset();
+	STATS_TIMER(context.stats, wallTime);
+
+	// initialize image with basic values
+	initializeImage(camera, context);
+
+	// do forward rendering pipeline operations
+	forwardRenderingPipeline(camera, context);
+
+	// generate PPM file
+	STATS_TIMER(context.stats, writeTime);
+	if(writePPM){
+		size_t bytes = writeImageToPPMFile(camera, context.image);
+		STATS_ADD(context.stats, bytesWritten, bytes);
+	}
+
+	// encode PNG file directly from the image, without ImageMagick
+	if(writePNG){
+		size_t bytes = writeImageToPNGFile(camera, context.image, context.tilePool);
+		STATS_ADD(context.stats, bytesWritten, bytes);
+	}
+}
+
+/*
+	Rasterizes the binned primitives, one screen tile per job.
+	Every pixel belongs to exactly one tile and each tile keeps submission order,
+	so workers never share pixels and the image matches a serial walk.
+	Without a tile pool the tiles are walked on the calling thread.
+	Each tile counts into its own stats, summed into context.stats at the end.
+*/
+void Scene::rasterizeBins(RenderContext &context) const
+{
+	STATS_TIMER(context.stats, rasterTime);
+	int tiles = context.bins.bins.size();
+	context.tileStats.assign(tiles, RenderStats());
+
+	if(context.tilePool == NULL){
+		for(int tile=0;tile<tiles;tile++){
+			rasterizeTile(context, tile);
+		}
+	}else{
+		context.tilePool->run(tiles, [this, &context](int tile){ rasterizeTile(context, tile); });
+	}
+
+	for(auto &t: context.tileStats){
+		context.stats.add(t);
+	}
+}
+
+/*
+	Worker pool with rasterThreads threads, recreated when the count changes.
+*/
+ThreadPool *Scene::getRasterPool()
+{
+	if(rasterPool == NULL || rasterPool->size() != rasterThreads){
+		delete rasterPool;
+		rasterPool = new ThreadPool(rasterThreads);
+	}
+	return rasterPool;
+}
+
+void Scene::rasterizeTile(RenderContext &context, int tile) const
+{
+	int minX, minY, maxX, maxY;
+	context.bins.getTileRect(tile, minX, minY, maxX, maxY);
+	RenderStats &stats = context.tileStats[tile];
+
+	for(int i: context.bins.bins[tile]){
+		Primitive &p = context.bins.primitives[i];
+		if(p.type == 0){
+			rasterizeLine(context, p.v[0], p.v[1], minX, minY, maxX, maxY, stats);
+		}else{
+			rasterizeTriangle(context, p.v[0], p.v[1], p.v[2], minX, minY, maxX, maxY, stats);
+		}
+	}
+}
+
+/*
+	Object space bounding volume of every mesh, for the per camera frustum test, and the
+	world space sphere that front-to-back mode sorts by. The sphere radius is scaled by
+	the longest column of the model matrix, which is exact for rotations and uniform
+	scalings and close enough for a sort key otherwise.
+*/
+void Scene::buildMeshBounds()
+{
+	for(auto m: meshes){
+		m->bounds.compute(vertexData, m->getVertexIndices());
+
+		const Matrix4 &T = transformCache.getMatrix(m->transformNode);
+		double scale = 0;
+		for(int j=0;j<3;j++){
+			scale = max(scale, T.val[0][j]*T.val[0][j] + T.val[1][j]*T.val[1][j] + T.val[2][j]*T.val[2][j]);
+		}
+		for(int i=0;i<3;i++){
+			m->sortCenter[i] = T.val[i][0]*m->bounds.center[0] + T.val[i][1]*m->bounds.center[1] + T.val[i][2]*m->bounds.center[2] + T.val[i][3];
+		}
+		m->sortRadius = m->bounds.isEmpty() ? -1 : m->bounds.radius*sqrt(scale);
+	}
+}
+
+/*
+	Builds the Bvh of every mesh with at least BVH_MIN_TRIANGLES triangles that has none
+	yet, e.g. from the scene cache. The top levels of each mesh are built first, then the
+	subtrees of all meshes are built together on the raster pool.
+*/
+void Scene::buildMeshBvhs()
+{
+	STATS_TIMER(*this, bvhBuildTime);
+
+	vector<Mesh*> pending;
+	for(auto m: meshes){
+		if(m->bvh.isEmpty() && m->getIndices().size()/3 >= BVH_MIN_TRIANGLES){
+			pending.push_back(m);
+		}
+	}
+	if(pending.empty()){
+		return;
+	}
+
+	ThreadPool *pool = getRasterPool();
+	vector<BvhBuilder> builders(pending.size());
+	pool->run(pending.size(), [this, &builders, &pending](int i){
+		builders[i].start(vertexData, pending[i]->getIndices());
+	});
+
+	vector< pair<int,int> > tasks;
+	for(int i=0;i<(int)builders.size();i++){
+		for(int task=0;task<builders[i].taskCount();task++){
+			tasks.push_back(make_pair(i, task));
+		}
+	}
+	pool->run(tasks.size(), [&builders, &tasks](int k){
+		builders[tasks[k].first].runTask(tasks[k].second);
+	});
+
+	for(int i=0;i<(int)builders.size();i++){
+		builders[i].finish(pending[i]->bvh);
+	}
+}
+
+/*
+	Transforms every vertex of the mesh once with the composed model-view-projection
+	matrix and, when outcodes is set, records which clip planes each vertex is outside of.
+	Triangles sharing a vertex read the cached results instead of recomputing them.
+*/
+void Scene::transformVertices(RenderContext &context, Mesh *mesh, const Matrix4 &modelToClip, bool outcodes) const
+{
+	Span<const uint32_t> ids = mesh->getVertexIndices();
+	int count = ids.size();
+	if(count == 0){
+		return;
+	}
+
+	//meshes usually own a run of consecutive vertices, transform those in place
+	int first = ids[0];
+	bool contiguous = (int)(ids[count-1]-ids[0]) == count-1;
+
+	const double *in[4] = {vertexData.x.data+first, vertexData.y.data+first, vertexData.z.data+first, NULL};
+	double *clip[4];
+	if(contiguous){
+		context.clipVertices.getPointers(clip, first);
+	}else{
+		//gather into scratch, transform, then scatter back below
+		context.meshVertices.resize(count);
+		context.meshClip.resize(count);
+		for(int i=0;i<count;i++){
+			context.meshVertices.x[i] = vertexData.x[ids[i]];
+			context.meshVertices.y[i] = vertexData.y[ids[i]];
+			context.meshVertices.z[i] = vertexData.z[ids[i]];
+		}
+		in[0] = context.meshVertices.x.data();
+		in[1] = context.meshVertices.y.data();
+		in[2] = context.meshVertices.z.data();
+		context.meshClip.getPointers(clip, 0);
+	}
+
+	transformPoints(modelToClip, in, clip, count);
+
+	if(!contiguous){
+		for(int i=0;i<count;i++){
+			context.clipVertices.set(ids[i], context.meshClip.get(i, 0));
+		}
+	}
+
+	if(!outcodes){
+		return;
+	}
+	for(uint32_t i: ids){
+		context.clipOutcodes[i] = clipOutcode(context.clipVertices.get(i, i+1), context.clipPlanes);
+	}
+}
+
+/*
+	Composes the model transform chain of every mesh into transformCache.
+	Meshes that share a prefix of their transformation list share its product.
+*/
+void Scene::buildTransformCache()
+{
+	transformCache.clear();
+
+	for(auto m: meshes){
+		int node = 0;
+		for(int i=0;i<(m->numberOfTransformations);i++){
+			int id=m->transformationIds[i];
+			char type=m->transformationTypes[i];
+
+			int child = transformCache.getChild(node,type,id);
+			if(child < 0){
+				Matrix4 step(getIdentityMatrix());
+				if(type=='r'){
+					step = rotations[id-1]->getMatrix();
+				}else if(type == 't'){
+					step = translations[id-1]->getMatrix();
+				}else if(type == 's'){
+					step = scalings[id-1]->getMatrix();
+				}else{
+					cerr<<"something went wrong."<<endl;
 				}
+				child = transformCache.addChild(node,type,id,step);
 			}
+			node = child;
 		}
+		m->transformNode = node;
 	}
 }
 
-void Scene::addPoints(int axis, double col, bool insideIsLeft, Vec4 a, Vec4 b, vector<Vec4> &points){
-	double distA = abs(a.getElementAt(axis)-col);
-	double distB = abs(b.getElementAt(axis)-col);
-	double t = (distA)/(distA+distB);
+/*
+	One Sutherland-Hodgman step for edge a->b against a clip plane:
+	adds the crossing point if the edge crosses the plane, then b if it is inside.
+*/
+void Scene::addPoints(const RenderContext &context, int plane, const ClipVertex &a, const ClipVertex &b, ClipVertex *points, int &count) const{
+	double distA = clipPlaneDistance(a.position, context.clipPlanes[plane]);
+	double distB = clipPlaneDistance(b.position, context.clipPlanes[plane]);
 
-	bool aInside = (a.getElementAt(axis) < col) ^ !insideIsLeft;
-	bool bInside = (b.getElementAt(axis) < col) ^ !insideIsLeft;
+	bool aInside = distA >= 0;
+	bool bInside = distB >= 0;
 
 	if(aInside ^ bInside){
-		colorsOfVertices.push_back(new Color(mix(indexColor(a.colorId),indexColor(b.colorId),t)));
-		Vec4 p = interpVec4(a,b,t);
-		p.colorId = colorsOfVertices.size();
-		points.push_back(p);
+		double t = distA/(distA-distB);
+		points[count++] = interpClipVertex(a,b,t);
 	}
 
 	if(bInside){
-		points.push_back(b);
+		points[count++] = b;
 	}
 }
 
-void Scene::clipTriangle(Vec4 a, Vec4 b, Vec4 c, vector<Vec4> &points){
-	vector<Vec4> p2;
-	p2.push_back(a);
-	p2.push_back(b);
-	p2.push_back(c);
-
-	//clip for each axis, and each column of the axis
-	for(int axis=0;axis<3;axis++){
-		for(int i=0;i<2;i++){
-			vector<Vec4> generatedP;
-			for(int p=0;p<p2.size();p++){
-				addPoints(axis,2*i-1,i,p2[p],p2[(p+1)%p2.size()],generatedP);
-			}
-			//cull if everything is outside
-			if(generatedP.size()<3){
-				return;
-			}
-			p2.clear();
-			p2.push_back(generatedP.back());
-			for(int p=0;p<generatedP.size()-1;p++){
-				p2.push_back(generatedP[p]);
-			}
+/*
+	Clips the clip space triangle in polygon[0..2] against the planes set in
+	the outcode mask. The result is left in polygon and its corner count is
+	returned, 0 if nothing is left. Works in two stack buffers, without allocating.
+*/
+int Scene::clipTriangle(const RenderContext &context, ClipVertex *polygon, int planes) const{
+	ClipVertex scratch[MAX_CLIP_VERTICES];
+	ClipVertex *in = polygon, *out = scratch;
+	int count = 3;
+
+	//clip against the planes that some corner is outside of
+	for(int plane=0;plane<6;plane++){
+		if(!(planes & (1<<plane))){
+			continue;
 		}
+		//generate from slot 1, then move the last point to the front
+		int generated = 1;
+		for(int p=0;p<count;p++){
+			addPoints(context, plane,in[p],in[(p+1)%count],out,generated);
+		}
+		count = generated-1;
+		//cull if everything is outside
+		if(count<3){
+			return 0;
+		}
+		out[0] = out[count];
+		swap(in,out);
 	}
 
-	//tessellate
-	for(int i=1;i<p2.size()-1;i++){
-		points.push_back(p2[0]);
-		points.push_back(p2[i]);
-		points.push_back(p2[i+1]);
+	if(in != polygon){
+		for(int p=0;p<count;p++){
+			polygon[p] = in[p];
+		}
 	}
+	return count;
 }
 
 bool visible(double den, double num, double &tE, double &tL){
@@ -221,30 +651,43 @@ bool visible(double den, double num, double &tE, double &tL){
 	return true;
 }
 
-void Scene::clipLine(Vec4 a, Vec4 b, vector<Vec4> &points){
+/*
+	Liang-Barsky in clip space, the line is a + t*(b-a) for t in [0,1].
+*/
+void Scene::clipLine(RenderContext &context, Vec4 a, Vec4 b, int outA, int outB, vector<Vec4> &points) const{
+	//both ends outside the same plane
+	if(outA & outB){
+		return;
+	}
+	//both ends inside
+	if((outA | outB) == 0){
+		points.push_back(a);
+		points.push_back(b);
+		return;
+	}
+	STATS_TIMER(context.stats, clipTime);
+
 	double tE=0, tL=1;
 	bool vis = true;
-	Vec4 d(b.x-a.x,b.y-a.y,b.z-a.z,0,-1);
-	for(int axis=0;axis<3;axis++){
-		vis = vis && visible(d.getElementAt(axis),-1-a.getElementAt(axis),tE,tL);
-		vis = vis && visible(-d.getElementAt(axis),a.getElementAt(axis)-1,tE,tL);
+	for(int plane=0;plane<6;plane++){
+		double distA = clipPlaneDistance(a, context.clipPlanes[plane]);
+		double distB = clipPlaneDistance(b, context.clipPlanes[plane]);
+		vis = vis && visible(distB-distA,-distA,tE,tL);
 	}
 	if(!vis) return;
 	Vec4 resA = a;
 	Vec4 resB = b;
-	Color ca = indexColor(a.colorId);
-	Color cb = indexColor(b.colorId);
+	Color ca = indexColor(context, a.colorId);
+	Color cb = indexColor(context, b.colorId);
 	const double E = 0.0000001;
 	if(tL<1){
-		colorsOfVertices.push_back(new Color(ca+(cb-ca)*tL));
 		Vec4 p = interpVec4(a,b,tL-E);
-		p.colorId = colorsOfVertices.size();
+		p.colorId = context.clipColors.addColor(ca+(cb-ca)*tL);
 		resB = p;
 	}
 	if(tE>0){
-		colorsOfVertices.push_back(new Color(ca+(cb-ca)*tE));
 		Vec4 p = interpVec4(a,b,tE+E);
-		p.colorId = colorsOfVertices.size();
+		p.colorId = context.clipColors.addColor(ca+(cb-ca)*tE);
 		resA = p;
 	}
 	points.push_back(resA);
@@ -252,15 +695,23 @@ void Scene::clipLine(Vec4 a, Vec4 b, vector<Vec4> &points){
 }
 
 
-Color Scene::indexColor(int colorId){
-	return *colorsOfVertices[colorId-1];
+/*
+	Color of a scene vertex, or of a point made by clipping in the current frame.
+*/
+Color Scene::indexColor(const RenderContext &context, int colorId) const{
+	if(colorId <= vertexData.size()){
+		return vertexData.colors[colorId-1];
+	}
+	return context.clipColors.getColor(colorId);
 }
 
-void Scene::rasterizeLine(Vec4 a, Vec4 b){
-	if(a.x>b.x)
-	swap(a,b);
+void Scene::rasterizeLine(RenderContext &context, ClipVertex va, ClipVertex vb, int clipMinX, int clipMinY, int clipMaxX, int clipMaxY, RenderStats &stats) const{
+	STATS_TIMER(stats, lineTime);
+	if(va.position.x>vb.position.x)
+	swap(va,vb);
 
-	Color c = indexColor(a.colorId);
+	Vec4 a = va.position, b = vb.position;
+	Color c = va.color;
 
 	int x0 = 0, y0 = 0;
 	int x1 = 0, y1 = 0;
@@ -289,7 +740,7 @@ void Scene::rasterizeLine(Vec4 a, Vec4 b){
 
 	int p = -2*dy + dx;
 
-	Color dc = indexColor(b.colorId) - c;
+	Color dc = vb.color - c;
 	dc.r /= dx;
 	dc.g /= dx;
 	dc.b /= dx;
@@ -305,7 +756,11 @@ void Scene::rasterizeLine(Vec4 a, Vec4 b){
 		if(flipY){
 			y-=2*curdy;
 		}
-		image[x][y] = c;
+		if(x>=clipMinX && x<=clipMaxX && y>=clipMinY && y<=clipMaxY){
+			context.image.setPixel(x, y, c);
+			STATS_ADD(stats, fragmentsTested, 1);
+			STATS_ADD(stats, fragmentsWritten, 1);
+		}
 		if(flipY){
 			y+=2*curdy;
 		}
@@ -324,298 +779,211 @@ void Scene::rasterizeLine(Vec4 a, Vec4 b){
 		c.addColor(dc);
 	}
 }
-int lineEq(int x0, int y0, int x1, int y1, int x, int y){
-	return x*(y0-y1) + y*(x1-x0) + x0*y1 - y0*x1;
-}
-int lineEqVec(Vec4 a, Vec4 b, int x, int y){
-	return lineEq(a.x, a.y, b.x, b.y, x, y);
-}
-void Scene::rasterizeTriangle(Vec4 a, Vec4 b, Vec4 c){
-
-	//? when should we round things?
-
-	int minX = min(min(round(a.x),round(b.x)),round(c.x));
-	int minY = min(min(round(a.y),round(b.y)),round(c.y));
-	int maxX = max(max(round(a.x),round(b.x)),round(c.x));
-	int maxY = max(max(round(a.y),round(b.y)),round(c.y));
-
-	// a.x = round(a.x); a.y = round(a.y); a.z = round(a.z);
-	// b.x = round(b.x); b.y = round(b.y); b.z = round(b.z);
-	// c.x = round(c.x); c.y = round(c.y); c.z = round(c.z);
-
-	for(int x=minX;x<=maxX;x++){
-		for(int y=minY;y<=maxY;y++){
-			double alpha = (double)lineEqVec(b, c, x, y) / lineEqVec(b, c, a.x, a.y);
-			double beta = (double)lineEqVec(c, a, x, y) / lineEqVec(c, a, b.x, b.y);
-			double gamma = (double)lineEqVec(a, b, x, y) / lineEqVec(a, b, c.x, c.y);
-			if(alpha>=0 && beta>=0 && gamma>=0){
-				Color col = indexColor(a.colorId)*alpha + indexColor(b.colorId)*beta + indexColor(c.colorId)*gamma;
-				image[x][y] = Color(round(col.r), round(col.g), round(col.b));
-				// image[x][y] = col; //we can also do this, but it changes the colors slightly(?)
-			}
-		}
+//edge function of the line through (x0,y0)-(x1,y1): f(x,y) = A*x + B*y + C
+class EdgeFunction{
+public:
+	int A, B, C;
+
+	EdgeFunction(int x0, int y0, int x1, int y1){
+		A = y0-y1;
+		B = x1-x0;
+		C = x0*y1 - y0*x1;
 	}
-	
-}
 
-/*
-	Parses XML file
-*/
-Scene::Scene(const char *xmlPath)
-{
-	const char *str;
-	XMLDocument xmlDoc;
-	XMLElement *pElement;
-
-	xmlDoc.LoadFile(xmlPath);
-
-	XMLNode *pRoot = xmlDoc.FirstChild();
-
-	// read background color
-	pElement = pRoot->FirstChildElement("BackgroundColor");
-	str = pElement->GetText();
-	sscanf(str, "%lf %lf %lf", &backgroundColor.r, &backgroundColor.g, &backgroundColor.b);
-
-	// read culling
-	pElement = pRoot->FirstChildElement("Culling");
-	if (pElement != NULL) {
-		str = pElement->GetText();
-		
-		if (strcmp(str, "enabled") == 0) {
-			cullingEnabled = true;
-		}
-		else {
-			cullingEnabled = false;
-		}
+	int at(int x, int y){
+		return x*A + y*B + C;
 	}
 
-	// read cameras
-	pElement = pRoot->FirstChildElement("Cameras");
-	XMLElement *pCamera = pElement->FirstChildElement("Camera");
-	XMLElement *camElement;
-	while (pCamera != NULL)
-	{
-		Camera *cam = new Camera();
-
-		pCamera->QueryIntAttribute("id", &cam->cameraId);
-
-		// read projection type
-		str = pCamera->Attribute("type");
-
-		if (strcmp(str, "orthographic") == 0) {
-			cam->projectionType = 0;
+	//clamps [lo,hi] to the columns of row y where the function is non-negative
+	void clampSpan(int y, int &lo, int &hi){
+		int f = y*B + C;
+		if(A > 0){
+			lo = max(lo, ceilDiv(-f, A));
+		}else if(A < 0){
+			hi = min(hi, floorDiv(f, -A));
+		}else if(f < 0){
+			hi = lo-1;
 		}
-		else {
-			cam->projectionType = 1;
-		}
-
-		camElement = pCamera->FirstChildElement("Position");
-		str = camElement->GetText();
-		sscanf(str, "%lf %lf %lf", &cam->pos.x, &cam->pos.y, &cam->pos.z);
-
-		camElement = pCamera->FirstChildElement("Gaze");
-		str = camElement->GetText();
-		sscanf(str, "%lf %lf %lf", &cam->gaze.x, &cam->gaze.y, &cam->gaze.z);
-
-		camElement = pCamera->FirstChildElement("Up");
-		str = camElement->GetText();
-		sscanf(str, "%lf %lf %lf", &cam->v.x, &cam->v.y, &cam->v.z);
-
-		cam->gaze = normalizeVec3(cam->gaze);
-		cam->u = crossProductVec3(cam->gaze, cam->v);
-		cam->u = normalizeVec3(cam->u);
-
-		cam->w = inverseVec3(cam->gaze);
-		cam->v = crossProductVec3(cam->u, cam->gaze);
-		cam->v = normalizeVec3(cam->v);
-
-		camElement = pCamera->FirstChildElement("ImagePlane");
-		str = camElement->GetText();
-		sscanf(str, "%lf %lf %lf %lf %lf %lf %d %d",
-			   &cam->left, &cam->right, &cam->bottom, &cam->top,
-			   &cam->near, &cam->far, &cam->horRes, &cam->verRes);
-
-		camElement = pCamera->FirstChildElement("OutputName");
-		str = camElement->GetText();
-		cam->outputFileName = string(str);
-
-		cameras.push_back(cam);
-
-		pCamera = pCamera->NextSiblingElement("Camera");
 	}
 
-	// read vertices
-	pElement = pRoot->FirstChildElement("Vertices");
-	XMLElement *pVertex = pElement->FirstChildElement("Vertex");
-	int vertexId = 1;
-
-	while (pVertex != NULL)
-	{
-		Vec3 *vertex = new Vec3();
-		Color *color = new Color();
-
-		vertex->colorId = vertexId;
-
-		str = pVertex->Attribute("position");
-		sscanf(str, "%lf %lf %lf", &vertex->x, &vertex->y, &vertex->z);
-
-		str = pVertex->Attribute("color");
-		sscanf(str, "%lf %lf %lf", &color->r, &color->g, &color->b);
-
-		vertices.push_back(vertex);
-		colorsOfVertices.push_back(color);
-
-		pVertex = pVertex->NextSiblingElement("Vertex");
-
-		vertexId++;
+	static int floorDiv(int a, int b){
+		return a/b - (a%b != 0 && (a<0) != (b<0));
 	}
-
-	// read translations
-	pElement = pRoot->FirstChildElement("Translations");
-	XMLElement *pTranslation = pElement->FirstChildElement("Translation");
-	while (pTranslation != NULL)
-	{
-		Translation *translation = new Translation();
-
-		pTranslation->QueryIntAttribute("id", &translation->translationId);
-
-		str = pTranslation->Attribute("value");
-		sscanf(str, "%lf %lf %lf", &translation->tx, &translation->ty, &translation->tz);
-
-		translations.push_back(translation);
-
-		pTranslation = pTranslation->NextSiblingElement("Translation");
+	static int ceilDiv(int a, int b){
+		return -floorDiv(-a, b);
 	}
+};
 
-	// read scalings
-	pElement = pRoot->FirstChildElement("Scalings");
-	XMLElement *pScaling = pElement->FirstChildElement("Scaling");
-	while (pScaling != NULL)
-	{
-		Scaling *scaling = new Scaling();
+void Scene::rasterizeTriangle(RenderContext &context, const ClipVertex &va, const ClipVertex &vb, const ClipVertex &vc, int clipMinX, int clipMinY, int clipMaxX, int clipMaxY, RenderStats &stats) const{
+	STATS_TIMER(stats, triangleTime);
+	const Vec4 &a = va.position, &b = vb.position, &c = vc.position;
 
-		pScaling->QueryIntAttribute("id", &scaling->scalingId);
-		str = pScaling->Attribute("value");
-		sscanf(str, "%lf %lf %lf", &scaling->sx, &scaling->sy, &scaling->sz);
-
-		scalings.push_back(scaling);
+	//? when should we round things?
 
-		pScaling = pScaling->NextSiblingElement("Scaling");
-	}
+	int minX = min(min(round(a.x),round(b.x)),round(c.x));
+	int minY = min(min(round(a.y),round(b.y)),round(c.y));
+	int maxX = max(max(round(a.x),round(b.x)),round(c.x));
+	int maxY = max(max(round(a.y),round(b.y)),round(c.y));
 
-	// read rotations
-	pElement = pRoot->FirstChildElement("Rotations");
-	XMLElement *pRotation = pElement->FirstChildElement("Rotation");
-	while (pRotation != NULL)
-	{
-		Rotation *rotation = new Rotation();
+	//only touch pixels inside the clip rectangle
+	minX = max(minX, clipMinX);
+	minY = max(minY, clipMinY);
+	maxX = min(maxX, clipMaxX);
+	maxY = min(maxY, clipMaxY);
 
-		pRotation->QueryIntAttribute("id", &rotation->rotationId);
-		str = pRotation->Attribute("value");
-		sscanf(str, "%lf %lf %lf %lf", &rotation->angle, &rotation->ux, &rotation->uy, &rotation->uz);
+	double minZ = min(min(a.z,b.z),c.z);
+	double maxZ = max(max(a.z,b.z),c.z);
 
-		rotations.push_back(rotation);
+	//edge functions use the truncated corner positions
+	int ax = a.x, ay = a.y, bx = b.x, by = b.y, cx = c.x, cy = c.y;
+	EdgeFunction eA(bx,by,cx,cy), eB(cx,cy,ax,ay), eC(ax,ay,bx,by);
 
-		pRotation = pRotation->NextSiblingElement("Rotation");
+	//twice the signed area, the denominator of every barycentric coordinate
+	int area = eA.at(ax,ay);
+	if(area == 0){
+		return;
+	}
+	//flip the edges of clockwise triangles so that inside is always non-negative
+	if(area < 0){
+		eA.A=-eA.A; eA.B=-eA.B; eA.C=-eA.C;
+		eB.A=-eB.A; eB.B=-eB.B; eB.C=-eB.C;
+		eC.A=-eC.A; eC.B=-eC.B; eC.C=-eC.C;
+		area = -area;
 	}
 
-	// read meshes
-	pElement = pRoot->FirstChildElement("Meshes");
-
-	XMLElement *pMesh = pElement->FirstChildElement("Mesh");
-	XMLElement *meshElement;
-	while (pMesh != NULL)
-	{
-		Mesh *mesh = new Mesh();
-
-		pMesh->QueryIntAttribute("id", &mesh->meshId);
+	SpanSetup setup;
+	setup.area = area;
+	setup.stepA = eA.A;
+	setup.stepB = eB.A;
+	setup.stepC = eC.A;
+	setup.za = a.z;
+	setup.zb = b.z;
+	setup.zc = c.z;
+	setup.colA = va.color;
+	setup.colB = vb.color;
+	setup.colC = vc.color;
+	setup.depthWrite = depthTestEnabled;
+
+	//walk the depth tiles covered by the bounding box
+	for(int ty=minY/DEPTH_TILE_SIZE;ty<=maxY/DEPTH_TILE_SIZE;ty++){
+		for(int tx=minX/DEPTH_TILE_SIZE;tx<=maxX/DEPTH_TILE_SIZE;tx++){
+			int tile = context.depthBuffer.tileIndex(tx,ty);
+
+			//whole block is behind what is already drawn
+			if(depthTestEnabled && minZ > context.depthBuffer.tileMax[tile]){
+				continue;
+			}
+			//whole block is in front of what is already drawn
+			setup.depthTest = depthTestEnabled && maxZ > context.depthBuffer.tileMin[tile];
+
+			int x0 = max(minX, tx*DEPTH_TILE_SIZE), x1 = min(maxX, (tx+1)*DEPTH_TILE_SIZE-1);
+			int y0 = max(minY, ty*DEPTH_TILE_SIZE), y1 = min(maxY, (ty+1)*DEPTH_TILE_SIZE-1);
+			bool written = false;
+
+			for(int y=y0;y<=y1;y++){
+				//covered span of this row, empty bounding box area is never visited
+				int spanLo = x0, spanHi = x1;
+				eA.clampSpan(y,spanLo,spanHi);
+				eB.clampSpan(y,spanLo,spanHi);
+				eC.clampSpan(y,spanLo,spanHi);
+				if(spanLo > spanHi){
+					continue;
+				}
 
-		// read projection type
-		str = pMesh->Attribute("type");
+				double *depthRow = &context.depthBuffer.depth[y*context.depthBuffer.width];
+				int passed = context.spanKernel(setup, y, spanLo, spanHi, eA.at(spanLo,y), eB.at(spanLo,y), eC.at(spanLo,y), depthRow, context.image);
+				STATS_ADD(stats, fragmentsTested, spanHi-spanLo+1);
+				STATS_ADD(stats, fragmentsWritten, passed);
+				if(passed){
+					written = true;
+				}
+			}
 
-		if (strcmp(str, "wireframe") == 0) {
-			mesh->type = 0;
-		}
-		else {
-			mesh->type = 1;
+			if(written){
+				context.depthBuffer.updateTile(tx,ty);
+			}
 		}
+	}
+	
+}
 
-		// read mesh transformations
-		XMLElement *pTransformations = pMesh->FirstChildElement("Transformations");
-		XMLElement *pTransformation = pTransformations->FirstChildElement("Transformation");
-
-		while (pTransformation != NULL)
-		{
-			char transformationType;
-			int transformationId;
-
-			str = pTransformation->GetText();
-			sscanf(str, "%c %d", &transformationType, &transformationId);
-
-			mesh->transformationTypes.push_back(transformationType);
-			mesh->transformationIds.push_back(transformationId);
-
-			pTransformation = pTransformation->NextSiblingElement("Transformation");
+/*
+	Loads the scene from its binary cache when that is up to date, otherwise
+	parses the scene XML file, streaming it straight into the scene arrays
+*/
+Scene::Scene(const char *xmlPath, bool useSceneCache)
+{
+	loadTime = 0;
+	STATS_TIMER(*this, loadTime);
+	depthTestEnabled = true;
+	occlusionCullingEnabled = false;
+	frontToBackEnabled = false;
+	bvhEnabled = true;
+	bvhBuildTime = 0;
+	rasterThreads = thread::hardware_concurrency() > 0 ? thread::hardware_concurrency() : 1;
+	rasterPool = NULL;
+	rasterIsa = ISA_AVX2;
+	imageFormat = FORMAT_RGBA8;
+	ppmFormat = PPM_P3;
+	cullingEnabled = false;
+
+	loadedFromCache = useSceneCache && SceneCache::load(this, xmlPath);
+	if(!loadedFromCache){
+		SceneLoader loader(this);
+		if(!loader.load(xmlPath)){
+			cerr<<loader.error<<endl;
+			exit(1);
 		}
+	}
 
-		mesh->numberOfTransformations = mesh->transformationIds.size();
-
-		// read mesh faces
-		char *row;
-		char *clone_str;
-		int v1, v2, v3;
-		XMLElement *pFaces = pMesh->FirstChildElement("Faces");
-        str = pFaces->GetText();
-		clone_str = strdup(str);
+	buildTransformCache();
+	buildMeshBounds();
+}
 
-		row = strtok(clone_str, "\n");
-		while (row != NULL)
-		{
-			int result = sscanf(row, "%d %d %d", &v1, &v2, &v3);
-			
-			if (result != EOF) {
-				mesh->triangles.push_back(Triangle(v1, v2, v3));
-			}
-			row = strtok(NULL, "\n");
-		}
-		mesh->numberOfTriangles = mesh->triangles.size();
-		meshes.push_back(mesh);
+/*
+	Writes the load time and the stats of every camera of the last renderCameras
+	as one JSON object. Times are in milliseconds.
+*/
+void Scene::writeStatsJson(ostream &os, const string &xmlPath) const
+{
+	RenderStats total;
+	for(auto &s: cameraStats){
+		total.add(s);
+	}
 
-		pMesh = pMesh->NextSiblingElement("Mesh");
+	os<<"{\n";
+	os<<"  \"scene\": "; writeJsonString(os, xmlPath); os<<",\n";
+	os<<"  \"statsEnabled\": "<<(RENDER_STATS ? "true" : "false")<<",\n";
+	os<<"  \"source\": \""<<(loadedFromCache ? "cache" : "xml")<<"\",\n";
+	os<<"  \"loadMs\": "<<fixed<<setprecision(3)<<loadTime/1e6<<",\n";
+	os<<"  \"bvhBuildMs\": "<<bvhBuildTime/1e6<<",\n";
+	os<<"  \"threads\": "<<rasterThreads<<",\n";
+	os<<"  \"cameras\": [";
+	for(size_t i=0;i<cameraStats.size();i++){
+		os<<(i ? ",\n" : "\n")<<"    {\n";
+		os<<"      \"id\": "<<cameras[i]->cameraId<<",\n";
+		os<<"      \"output\": "; writeJsonString(os, cameras[i]->outputFileName); os<<",\n";
+		os<<"      \"width\": "<<cameras[i]->horRes<<",\n";
+		os<<"      \"height\": "<<cameras[i]->verRes<<",\n";
+		cameraStats[i].writeJsonFields(os, "      ");
+		os<<"    }";
 	}
+	os<<"\n  ],\n";
+	os<<"  \"total\": {\n";
+	total.writeJsonFields(os, "    ");
+	os<<"  }\n";
+	os<<"}"<<endl;
 }
 
 /*
-	Initializes image with background color
+	Initializes the context's image with background color and resets its depth buffer
 */
-void Scene::initializeImage(Camera *camera)
+void Scene::initializeImage(Camera *camera, RenderContext &context) const
 {
-	if (this->image.empty())
-	{
-		for (int i = 0; i < camera->horRes; i++)
-		{
-			vector<Color> rowOfColors;
-
-			for (int j = 0; j < camera->verRes; j++)
-			{
-				rowOfColors.push_back(this->backgroundColor);
-			}
+	context.depthBuffer.initialize(camera->horRes, camera->verRes);
 
-			this->image.push_back(rowOfColors);
-		}
-	}
-	else
-	{
-		for (int i = 0; i < camera->horRes; i++)
-		{
-			for (int j = 0; j < camera->verRes; j++)
-			{
-				this->image[i][j].r = this->backgroundColor.r;
-				this->image[i][j].g = this->backgroundColor.g;
-				this->image[i][j].b = this->backgroundColor.b;
-			}
-		}
-	}
+	context.image.initialize(camera->horRes, camera->verRes, this->imageFormat);
+	context.image.clear(this->backgroundColor);
 }
 
 /*
@@ -623,7 +991,7 @@ void Scene::initializeImage(Camera *camera)
 	If given value is more than 255, converts value to 255.
 	Otherwise returns value itself.
 */
-int Scene::makeBetweenZeroAnd255(double value)
+int Scene::makeBetweenZeroAnd255(double value) const
 {
 	if (value >= 255.0)
 		return 255;
@@ -633,12 +1001,28 @@ int Scene::makeBetweenZeroAnd255(double value)
 }
 
 /*
-	Writes contents of image (Color**) into a PPM file.
+	Writes contents of image (Framebuffer) into a PPM file.
+	PPM_P3 writes ASCII text, PPM_P6 writes binary.
+	Returns the size of the file.
 */
-void Scene::writeImageToPPMFile(Camera *camera)
+size_t Scene::writeImageToPPMFile(Camera *camera, const Framebuffer &image) const
 {
 	ofstream fout;
 
+	if (this->ppmFormat == PPM_P6)
+	{
+		// header and pixels go out in one write
+		string header = "P6\n# " + camera->outputFileName + "\n" + to_string(camera->horRes) + " " + to_string(camera->verRes) + "\n255\n";
+		vector<char> buffer(header.size() + (size_t)camera->horRes * camera->verRes * 3);
+		memcpy(buffer.data(), header.data(), header.size());
+		image.packRGB((uint8_t *)buffer.data() + header.size());
+
+		fout.open(camera->outputFileName.c_str(), ios::binary);
+		fout.write(buffer.data(), buffer.size());
+		fout.close();
+		return buffer.size();
+	}
+
 	fout.open(camera->outputFileName.c_str());
 
 	fout << "P3" << endl;
@@ -650,41 +1034,34 @@ void Scene::writeImageToPPMFile(Camera *camera)
 	{
 		for (int i = 0; i < camera->horRes; i++)
 		{
-			fout << makeBetweenZeroAnd255(this->image[i][j].r) << " "
-				 << makeBetweenZeroAnd255(this->image[i][j].g) << " "
-				 << makeBetweenZeroAnd255(this->image[i][j].b) << " ";
+			Color c = image.getPixel(i, j);
+			fout << makeBetweenZeroAnd255(c.r) << " "
+				 << makeBetweenZeroAnd255(c.g) << " "
+				 << makeBetweenZeroAnd255(c.b) << " ";
 		}
 		fout << endl;
 	}
+	size_t bytes = fout.tellp();
 	fout.close();
+	return bytes;
 }
 
 /*
-	Converts PPM image in given path to PNG file, by calling ImageMagick's 'convert' command.
-	os_type == 1 		-> Ubuntu
-	os_type == 2 		-> Windows
-	os_type == other	-> No conversion
+	Encodes image straight into <outputFileName>.png, no PPM file is needed.
+	Bands of the image are compressed on pool when it is given.
+	Returns the size of the file, 0 when it could not be written.
 */
-void Scene::convertPPMToPNG(string ppmFileName, int osType)
+size_t Scene::writeImageToPNGFile(Camera *camera, const Framebuffer &image, ThreadPool *pool) const
 {
-	string command;
+	vector<uint8_t> rgb((size_t)camera->horRes * camera->verRes * 3);
+	image.packRGB(rgb.data());
 
-	// call command on Ubuntu
-	if (osType == 1)
-	{
-		command = "convert " + ppmFileName + " " + ppmFileName + ".png";
-		system(command.c_str());
-	}
-
-	// call command on Windows
-	else if (osType == 2)
-	{
-		command = "magick convert " + ppmFileName + " " + ppmFileName + ".png";
-		system(command.c_str());
-	}
-
-	// default action - don't do conversion
-	else
+	string pngFileName = camera->outputFileName + ".png";
+	size_t bytes = 0;
+	if (!PngWriter::write(pngFileName, camera->horRes, camera->verRes, rgb.data(), pool, &bytes))
 	{
+		cerr << "could not write " << pngFileName << endl;
+		return 0;
 	}
-}
\ No newline at end of file
+	return bytes;
+}
@@ -8,50 +8,96 @@
 #include <string>
 #include <vector>
 
+#include "AttributePool.h"
 #include "Camera.h"
+#include "ClipVertex.h"
 #include "Color.h"
+#include "DepthBuffer.h"
+#include "Framebuffer.h"
+#include "MappedFile.h"
 #include "Mesh.h"
+#include "RasterBins.h"
+#include "RasterKernel.h"
+#include "RenderContext.h"
+#include "RenderStats.h"
 #include "Rotation.h"
 #include "Scaling.h"
+#include "ThreadPool.h"
+#include "TransformCache.h"
 #include "Translation.h"
 #include "Triangle.h"
 #include "Vec3.h"
 #include "Vec4.h"
+#include "Vec4Array.h"
+#include "VertexBuffer.h"
 
 using namespace std;
 
+#define PPM_P3 0 // ASCII, like the reference outputs
+#define PPM_P6 1 // binary
+
+#define OCCLUSION_DEPTH_EPSILON 1e-9 // relative depth margin of the occlusion test
+
 class Scene
 {
 public:
 	Color backgroundColor;
 	bool cullingEnabled;
-	bool drawingMode; //0: wireframe, 1:solid
+	bool depthTestEnabled; //false: solids are drawn in input order
+	bool bvhEnabled; //cull the triangles of large meshes through their Bvh
+	bool occlusionCullingEnabled; //skip solid meshes hidden behind earlier ones, needs the depth test
+	bool frontToBackEnabled; //draw solids nearest first and wireframes after them, needs the depth test
 
-	vector< vector<Color> > image;
+	int imageFormat; //FORMAT_RGBA8 or FORMAT_FLOAT
+	int ppmFormat; //PPM_P3 or PPM_P6
+	int rasterThreads;
+	ThreadPool *rasterPool;
+	int rasterIsa; //widest span kernel allowed, see RasterKernel.h
 	vector< Camera* > cameras;
-	vector< Vec3* > vertices;
-	vector< Color* > colorsOfVertices;
+	VertexBuffer vertexData;
+	MappedFile cacheFile; //scene cache the vertex and index arrays may point into
 	vector< Scaling* > scalings;
 	vector< Rotation* > rotations;
 	vector< Translation* > translations;
 	vector< Mesh* > meshes;
+	TransformCache transformCache; //model matrices of the meshes, see buildTransformCache
+
+	uint64_t loadTime; //nanoseconds spent in the constructor, 0 without RENDER_STATS
+	bool loadedFromCache;
+	uint64_t bvhBuildTime; //nanoseconds, 0 when every Bvh came from the cache
+	vector< RenderStats > cameraStats; //one per camera, filled by renderCameras
+
+	Scene(const char *xmlPath, bool useSceneCache = true);
+
+	void buildTransformCache();
+	void buildMeshBounds();
+	void buildMeshBvhs();
+	void renderCameras(bool writePPM, bool writePNG);
 
-	Scene(const char *xmlPath);
+	//rendering only reads the scene, everything a camera writes lives in its RenderContext
+	void renderCamera(Camera* camera, RenderContext &context, bool writePPM, bool writePNG) const;
+	void initializeImage(Camera* camera, RenderContext &context) const;
+	void forwardRenderingPipeline(Camera* camera, RenderContext &context) const;
+	const vector< Mesh* > &meshDrawOrder(Camera* camera, RenderContext &context) const;
+	bool isMeshOccluded(RenderContext &context, const Mesh *mesh, const Matrix4 &modelToScreen, bool reusePyramid) const;
+	void transformVertices(RenderContext &context, Mesh* mesh, const Matrix4 &modelToClip, bool outcodes) const;
+	int makeBetweenZeroAnd255(double value) const;
+	size_t writeImageToPPMFile(Camera* camera, const Framebuffer &image) const;
+	size_t writeImageToPNGFile(Camera* camera, const Framebuffer &image, ThreadPool *pool) const;
 
-	void initializeImage(Camera* camera);
-	void forwardRenderingPipeline(Camera* camera);
-	int makeBetweenZeroAnd255(double value);
-	void writeImageToPPMFile(Camera* camera);
-	void convertPPMToPNG(string ppmFileName, int osType);
+	Color indexColor(const RenderContext &context, int colorId) const;
+	void addPoints(const RenderContext &context, int plane, const ClipVertex &a, const ClipVertex &b, ClipVertex *points, int &count) const;
 
-	Color indexColor(int colorId);
-	void addPoints(int axis, double col, bool insideIsLeft, Vec4 a, Vec4 b, vector<Vec4> &points);
+	void clipLine(RenderContext &context, Vec4 a, Vec4 b, int outA, int outB, vector<Vec4> &points) const;
+	int clipTriangle(const RenderContext &context, ClipVertex *polygon, int planes) const;
 
-	void clipLine(Vec4 a, Vec4 b, vector<Vec4> &points);
-	void clipTriangle(Vec4 a, Vec4 b, Vec4 c, vector<Vec4> &points);
+	ThreadPool *getRasterPool();
+	void rasterizeBins(RenderContext &context) const;
+	void rasterizeTile(RenderContext &context, int tile) const;
+	void rasterizeLine(RenderContext &context, ClipVertex a, ClipVertex b, int clipMinX, int clipMinY, int clipMaxX, int clipMaxY, RenderStats &stats) const;
+	void rasterizeTriangle(RenderContext &context, const ClipVertex &a, const ClipVertex &b, const ClipVertex &c, int clipMinX, int clipMinY, int clipMaxX, int clipMaxY, RenderStats &stats) const;
 
-	void rasterizeLine(Vec4 a, Vec4 b);
-	void rasterizeTriangle(Vec4 a, Vec4 b, Vec4 c);
+	void writeStatsJson(ostream &os, const string &xmlPath) const;
 };
 
 #endif
@@ -0,0 +1,544 @@
+#include "SceneCache.h"
+#include "Scene.h"
+#include "MappedFile.h"
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sys/stat.h>
+
+static const char CACHE_MAGIC[8] = {'R', 'S', 'C', 'A', 'C', 'H', 'E', 0};
+static const uint32_t CACHE_BYTE_ORDER = 0x01020304;
+
+static_assert(sizeof(Color) == 3 * sizeof(double), "colors are stored as packed r, g, b doubles");
+
+class CacheHeader
+{
+public:
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    uint32_t sectionCount;
+    uint32_t reserved;
+    uint64_t sourceSize;
+    int64_t sourceMtime;
+    uint64_t sourceHash;
+};
+
+class CacheSection
+{
+public:
+    uint32_t type;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+};
+
+class SettingsRecord
+{
+public:
+    double background[3];
+    uint32_t cullingEnabled;
+    uint32_t reserved;
+};
+
+class CameraRecord
+{
+public:
+    int32_t cameraId, projectionType;
+    double pos[3], gaze[3], u[3], v[3], w[3];
+    double left, right, bottom, top, near, far;
+    int32_t horRes, verRes;
+    uint32_t nameOffset, nameLength; // in SECTION_STRINGS
+};
+
+class TransformRecord
+{
+public:
+    int32_t id;
+    int32_t reserved;
+    double values[4];
+};
+
+class MeshRecord
+{
+public:
+    int32_t meshId, type;
+    uint32_t firstStep, stepCount; // in SECTION_MESH_STEPS
+    uint64_t firstIndex, indexCount; // in SECTION_INDICES
+    uint64_t firstVertexIndex, vertexIndexCount; // in SECTION_VERTEX_INDICES
+    uint64_t firstBvhNode, bvhNodeCount; // in SECTION_BVH_NODES, no nodes for meshes without a Bvh
+    uint64_t firstBvhOrder, bvhOrderCount; // in SECTION_BVH_ORDER
+};
+
+class StepRecord
+{
+public:
+    int32_t type, id;
+};
+
+/*
+ * Sections collected in memory before the file is laid out.
+ */
+class CacheBuilder
+{
+public:
+    vector<uint32_t> types;
+    vector<string> blobs;
+
+    void add(uint32_t type, const void *data, size_t size)
+    {
+        types.push_back(type);
+        blobs.push_back(string((const char *)data, size));
+    }
+
+    template <typename T>
+    void add(uint32_t type, const vector<T> &records)
+    {
+        add(type, records.data(), records.size() * sizeof(T));
+    }
+};
+
+static void storeVec3(double *out, const Vec3 &v)
+{
+    out[0] = v.x;
+    out[1] = v.y;
+    out[2] = v.z;
+}
+
+static Vec3 loadVec3(const double *in)
+{
+    return Vec3(in[0], in[1], in[2], -1);
+}
+
+static uint64_t alignUp(uint64_t offset)
+{
+    return (offset + SCENE_CACHE_ALIGNMENT - 1) / SCENE_CACHE_ALIGNMENT * SCENE_CACHE_ALIGNMENT;
+}
+
+bool SceneSource::read(const string &xmlPath, bool withHash)
+{
+    struct stat info;
+    if (stat(xmlPath.c_str(), &info) != 0)
+    {
+        return false;
+    }
+    size = info.st_size;
+    mtime = (int64_t)info.st_mtim.tv_sec * 1000000000 + info.st_mtim.tv_nsec;
+    hash = 0;
+
+    if (withHash)
+    {
+        MappedFile file;
+        if (!file.open(xmlPath))
+        {
+            return false;
+        }
+        hash = 14695981039346656037ULL;
+        for (size_t i = 0; i < file.size; i++)
+        {
+            hash = (hash ^ (unsigned char)file.data[i]) * 1099511628211ULL;
+        }
+    }
+    return true;
+}
+
+string SceneCache::pathFor(const string &xmlPath)
+{
+    return xmlPath + ".cache";
+}
+
+bool SceneCache::write(const Scene &scene, const string &xmlPath)
+{
+    SceneSource source;
+    if (!source.read(xmlPath, true))
+    {
+        return false;
+    }
+
+    CacheBuilder builder;
+
+    SettingsRecord settings;
+    memset(&settings, 0, sizeof(settings));
+    settings.background[0] = scene.backgroundColor.r;
+    settings.background[1] = scene.backgroundColor.g;
+    settings.background[2] = scene.backgroundColor.b;
+    settings.cullingEnabled = scene.cullingEnabled;
+    builder.add(SECTION_SETTINGS, &settings, sizeof(settings));
+
+    vector<CameraRecord> cameras;
+    string strings;
+    for (int i = 0; i < scene.cameras.size(); i++)
+    {
+        const Camera *c = scene.cameras[i];
+        CameraRecord r;
+        memset(&r, 0, sizeof(r));
+        r.cameraId = c->cameraId;
+        r.projectionType = c->projectionType;
+        storeVec3(r.pos, c->pos);
+        storeVec3(r.gaze, c->gaze);
+        storeVec3(r.u, c->u);
+        storeVec3(r.v, c->v);
+        storeVec3(r.w, c->w);
+        r.left = c->left;
+        r.right = c->right;
+        r.bottom = c->bottom;
+        r.top = c->top;
+        r.near = c->near;
+        r.far = c->far;
+        r.horRes = c->horRes;
+        r.verRes = c->verRes;
+        r.nameOffset = strings.size();
+        r.nameLength = c->outputFileName.size();
+        strings += c->outputFileName;
+        cameras.push_back(r);
+    }
+    builder.add(SECTION_CAMERAS, cameras);
+    builder.add(SECTION_STRINGS, strings.data(), strings.size());
+
+    const VertexBuffer &vertices = scene.vertexData;
+    builder.add(SECTION_VERTEX_X, vertices.x.data, vertices.size() * sizeof(double));
+    builder.add(SECTION_VERTEX_Y, vertices.y.data, vertices.size() * sizeof(double));
+    builder.add(SECTION_VERTEX_Z, vertices.z.data, vertices.size() * sizeof(double));
+    builder.add(SECTION_COLORS, vertices.colors.data, vertices.size() * sizeof(Color));
+
+    vector<TransformRecord> transforms;
+    for (int i = 0; i < scene.translations.size(); i++)
+    {
+        const Translation *t = scene.translations[i];
+        TransformRecord r = {t->translationId, 0, {t->tx, t->ty, t->tz, 0}};
+        transforms.push_back(r);
+    }
+    builder.add(SECTION_TRANSLATIONS, transforms);
+
+    transforms.clear();
+    for (int i = 0; i < scene.scalings.size(); i++)
+    {
+        const Scaling *s = scene.scalings[i];
+        TransformRecord r = {s->scalingId, 0, {s->sx, s->sy, s->sz, 0}};
+        transforms.push_back(r);
+    }
+    builder.add(SECTION_SCALINGS, transforms);
+
+    transforms.clear();
+    for (int i = 0; i < scene.rotations.size(); i++)
+    {
+        const Rotation *r = scene.rotations[i];
+        TransformRecord record = {r->rotationId, 0, {r->angle, r->ux, r->uy, r->uz}};
+        transforms.push_back(record);
+    }
+    builder.add(SECTION_ROTATIONS, transforms);
+
+    vector<MeshRecord> meshes;
+    vector<StepRecord> steps;
+    vector<uint32_t> indices, vertexIndices;
+    vector<BvhNode> bvhNodes;
+    vector<uint32_t> bvhOrder;
+    for (int i = 0; i < scene.meshes.size(); i++)
+    {
+        const Mesh *m = scene.meshes[i];
+        Span<const uint32_t> meshIndices = m->getIndices();
+        Span<const uint32_t> meshVertexIndices = m->getVertexIndices();
+
+        MeshRecord r;
+        memset(&r, 0, sizeof(r));
+        r.meshId = m->meshId;
+        r.type = m->type;
+        r.firstStep = steps.size();
+        r.stepCount = m->numberOfTransformations;
+        r.firstIndex = indices.size();
+        r.indexCount = meshIndices.size();
+        r.firstVertexIndex = vertexIndices.size();
+        r.vertexIndexCount = meshVertexIndices.size();
+        r.firstBvhNode = bvhNodes.size();
+        r.bvhNodeCount = m->bvh.nodes.size();
+        r.firstBvhOrder = bvhOrder.size();
+        r.bvhOrderCount = m->bvh.order.size();
+        meshes.push_back(r);
+
+        for (int j = 0; j < m->numberOfTransformations; j++)
+        {
+            StepRecord step = {m->transformationTypes[j], m->transformationIds[j]};
+            steps.push_back(step);
+        }
+        indices.insert(indices.end(), meshIndices.begin(), meshIndices.end());
+        vertexIndices.insert(vertexIndices.end(), meshVertexIndices.begin(), meshVertexIndices.end());
+        bvhNodes.insert(bvhNodes.end(), m->bvh.nodes.begin(), m->bvh.nodes.end());
+        bvhOrder.insert(bvhOrder.end(), m->bvh.order.begin(), m->bvh.order.end());
+    }
+    builder.add(SECTION_MESHES, meshes);
+    builder.add(SECTION_MESH_STEPS, steps);
+    builder.add(SECTION_INDICES, indices);
+    builder.add(SECTION_VERTEX_INDICES, vertexIndices);
+    builder.add(SECTION_BVH_NODES, bvhNodes);
+    builder.add(SECTION_BVH_ORDER, bvhOrder);
+
+    // lay out header, section table, then the aligned sections
+    CacheHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CACHE_MAGIC, sizeof(CACHE_MAGIC));
+    header.version = SCENE_CACHE_VERSION;
+    header.byteOrder = CACHE_BYTE_ORDER;
+    header.sectionCount = builder.blobs.size();
+    header.sourceSize = source.size;
+    header.sourceMtime = source.mtime;
+    header.sourceHash = source.hash;
+
+    vector<CacheSection> table(builder.blobs.size());
+    uint64_t offset = alignUp(sizeof(header) + table.size() * sizeof(CacheSection));
+    for (int i = 0; i < table.size(); i++)
+    {
+        table[i].type = builder.types[i];
+        table[i].reserved = 0;
+        table[i].offset = offset;
+        table[i].size = builder.blobs[i].size();
+        offset = alignUp(offset + table[i].size);
+    }
+
+    // write to a temporary name first so readers never see a partial cache
+    string path = pathFor(xmlPath);
+    string temporary = path + ".tmp";
+    ofstream out(temporary.c_str(), ios::out | ios::binary | ios::trunc);
+    if (!out)
+    {
+        return false;
+    }
+    out.write((const char *)&header, sizeof(header));
+    out.write((const char *)table.data(), table.size() * sizeof(CacheSection));
+    static const char padding[SCENE_CACHE_ALIGNMENT] = {0};
+    uint64_t written = sizeof(header) + table.size() * sizeof(CacheSection);
+    for (int i = 0; i < table.size(); i++)
+    {
+        out.write(padding, table[i].offset - written);
+        out.write(builder.blobs[i].data(), table[i].size);
+        written = table[i].offset + table[i].size;
+    }
+    out.close();
+    if (!out)
+    {
+        remove(temporary.c_str());
+        return false;
+    }
+    return rename(temporary.c_str(), path.c_str()) == 0;
+}
+
+/*
+ * Finds a section and checks that it holds whole records of size recordSize.
+ */
+static bool findSection(const MappedFile &file, const CacheSection *table, int count, uint32_t type,
+                        size_t recordSize, const char *&data, size_t &records)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (table[i].type != type)
+        {
+            continue;
+        }
+        if (table[i].offset % SCENE_CACHE_ALIGNMENT != 0 || table[i].offset > file.size ||
+            table[i].size > file.size - table[i].offset || table[i].size % recordSize != 0)
+        {
+            return false;
+        }
+        data = file.data + table[i].offset;
+        records = table[i].size / recordSize;
+        return true;
+    }
+    return false;
+}
+
+bool SceneCache::load(Scene *scene, const string &xmlPath)
+{
+    MappedFile &file = scene->cacheFile;
+    if (!file.open(pathFor(xmlPath)))
+    {
+        return false;
+    }
+
+    const CacheHeader *header = (const CacheHeader *)file.data;
+    if (file.size < sizeof(CacheHeader) || memcmp(header->magic, CACHE_MAGIC, sizeof(CACHE_MAGIC)) != 0 ||
+        header->version != SCENE_CACHE_VERSION || header->byteOrder != CACHE_BYTE_ORDER ||
+        header->sectionCount > (file.size - sizeof(CacheHeader)) / sizeof(CacheSection))
+    {
+        file.close();
+        return false;
+    }
+
+    // a touched but unchanged XML still matches by contents
+    SceneSource source;
+    if (!source.read(xmlPath, false) || source.size != header->sourceSize ||
+        (source.mtime != header->sourceMtime &&
+         (!source.read(xmlPath, true) || source.hash != header->sourceHash)))
+    {
+        file.close();
+        return false;
+    }
+
+    const CacheSection *table = (const CacheSection *)(file.data + sizeof(CacheHeader));
+    int count = header->sectionCount;
+
+    const char *settingsData, *cameraData, *stringData, *xData, *yData, *zData, *colorData;
+    const char *translationData, *scalingData, *rotationData, *meshData, *stepData, *indexData, *vertexIndexData;
+    const char *bvhNodeData, *bvhOrderData;
+    size_t settingsCount, cameraCount, stringCount, xCount, yCount, zCount, colorCount;
+    size_t translationCount, scalingCount, rotationCount, meshCount, stepCount, indexCount, vertexIndexCount;
+    size_t bvhNodeCount, bvhOrderCount;
+
+    if (!findSection(file, table, count, SECTION_SETTINGS, sizeof(SettingsRecord), settingsData, settingsCount) ||
+        !findSection(file, table, count, SECTION_CAMERAS, sizeof(CameraRecord), cameraData, cameraCount) ||
+        !findSection(file, table, count, SECTION_STRINGS, 1, stringData, stringCount) ||
+        !findSection(file, table, count, SECTION_VERTEX_X, sizeof(double), xData, xCount) ||
+        !findSection(file, table, count, SECTION_VERTEX_Y, sizeof(double), yData, yCount) ||
+        !findSection(file, table, count, SECTION_VERTEX_Z, sizeof(double), zData, zCount) ||
+        !findSection(file, table, count, SECTION_COLORS, sizeof(Color), colorData, colorCount) ||
+        !findSection(file, table, count, SECTION_TRANSLATIONS, sizeof(TransformRecord), translationData, translationCount) ||
+        !findSection(file, table, count, SECTION_SCALINGS, sizeof(TransformRecord), scalingData, scalingCount) ||
+        !findSection(file, table, count, SECTION_ROTATIONS, sizeof(TransformRecord), rotationData, rotationCount) ||
+        !findSection(file, table, count, SECTION_MESHES, sizeof(MeshRecord), meshData, meshCount) ||
+        !findSection(file, table, count, SECTION_MESH_STEPS, sizeof(StepRecord), stepData, stepCount) ||
+        !findSection(file, table, count, SECTION_INDICES, sizeof(uint32_t), indexData, indexCount) ||
+        !findSection(file, table, count, SECTION_VERTEX_INDICES, sizeof(uint32_t), vertexIndexData, vertexIndexCount) ||
+        !findSection(file, table, count, SECTION_BVH_NODES, sizeof(BvhNode), bvhNodeData, bvhNodeCount) ||
+        !findSection(file, table, count, SECTION_BVH_ORDER, sizeof(uint32_t), bvhOrderData, bvhOrderCount) ||
+        settingsCount != 1 || yCount != xCount || zCount != xCount || colorCount != xCount)
+    {
+        file.close();
+        return false;
+    }
+
+    // check every range before touching the scene, so a bad cache falls back cleanly
+    const CameraRecord *cameraRecords = (const CameraRecord *)cameraData;
+    for (size_t i = 0; i < cameraCount; i++)
+    {
+        if (cameraRecords[i].nameOffset > stringCount || cameraRecords[i].nameLength > stringCount - cameraRecords[i].nameOffset)
+        {
+            file.close();
+            return false;
+        }
+    }
+    const MeshRecord *meshRecords = (const MeshRecord *)meshData;
+    for (size_t i = 0; i < meshCount; i++)
+    {
+        const MeshRecord &r = meshRecords[i];
+        if (r.firstStep > stepCount || r.stepCount > stepCount - r.firstStep ||
+            r.firstIndex > indexCount || r.indexCount > indexCount - r.firstIndex || r.indexCount % 3 != 0 ||
+            r.firstVertexIndex > vertexIndexCount || r.vertexIndexCount > vertexIndexCount - r.firstVertexIndex ||
+            r.firstBvhNode > bvhNodeCount || r.bvhNodeCount > bvhNodeCount - r.firstBvhNode ||
+            r.firstBvhOrder > bvhOrderCount || r.bvhOrderCount > bvhOrderCount - r.firstBvhOrder)
+        {
+            file.close();
+            return false;
+        }
+    }
+    // buildTransformCache looks the steps up without checking them
+    const StepRecord *stepRecords = (const StepRecord *)stepData;
+    for (size_t i = 0; i < stepCount; i++)
+    {
+        const StepRecord &step = stepRecords[i];
+        size_t available = step.type == 'r' ? rotationCount : (step.type == 't' ? translationCount : (step.type == 's' ? scalingCount : 0));
+        if (step.id < 1 || (size_t)step.id > available)
+        {
+            file.close();
+            return false;
+        }
+    }
+    const BvhNode *bvhNodes = (const BvhNode *)bvhNodeData;
+    const uint32_t *bvhOrder = (const uint32_t *)bvhOrderData;
+    for (size_t i = 0; i < meshCount; i++)
+    {
+        const MeshRecord &r = meshRecords[i];
+        Bvh bvh;
+        bvh.useExternal(Span<const BvhNode>(bvhNodes + r.firstBvhNode, r.bvhNodeCount),
+                        Span<const uint32_t>(bvhOrder + r.firstBvhOrder, r.bvhOrderCount));
+        if (!bvh.isValid(r.indexCount / 3))
+        {
+            file.close();
+            return false;
+        }
+    }
+    const uint32_t *indices = (const uint32_t *)indexData;
+    const uint32_t *vertexIndices = (const uint32_t *)vertexIndexData;
+    uint32_t largest = 0;
+    for (size_t i = 0; i < indexCount; i++)
+    {
+        largest = max(largest, indices[i]);
+    }
+    for (size_t i = 0; i < vertexIndexCount; i++)
+    {
+        largest = max(largest, vertexIndices[i]);
+    }
+    if ((indexCount > 0 || vertexIndexCount > 0) && largest >= xCount)
+    {
+        file.close();
+        return false;
+    }
+
+    const SettingsRecord *settings = (const SettingsRecord *)settingsData;
+    scene->backgroundColor = Color(settings->background[0], settings->background[1], settings->background[2]);
+    scene->cullingEnabled = settings->cullingEnabled != 0;
+
+    for (size_t i = 0; i < cameraCount; i++)
+    {
+        const CameraRecord &r = cameraRecords[i];
+        Camera *c = new Camera();
+        c->cameraId = r.cameraId;
+        c->projectionType = r.projectionType;
+        c->pos = loadVec3(r.pos);
+        c->gaze = loadVec3(r.gaze);
+        c->u = loadVec3(r.u);
+        c->v = loadVec3(r.v);
+        c->w = loadVec3(r.w);
+        c->left = r.left;
+        c->right = r.right;
+        c->bottom = r.bottom;
+        c->top = r.top;
+        c->near = r.near;
+        c->far = r.far;
+        c->horRes = r.horRes;
+        c->verRes = r.verRes;
+        c->outputFileName = string(stringData + r.nameOffset, r.nameLength);
+        scene->cameras.push_back(c);
+    }
+
+    scene->vertexData.useExternal(Span<const double>((const double *)xData, xCount),
+                                  Span<const double>((const double *)yData, yCount),
+                                  Span<const double>((const double *)zData, zCount),
+                                  Span<const Color>((const Color *)colorData, colorCount));
+
+    const TransformRecord *t = (const TransformRecord *)translationData;
+    for (size_t i = 0; i < translationCount; i++)
+    {
+        scene->translations.push_back(new Translation(t[i].id, t[i].values[0], t[i].values[1], t[i].values[2]));
+    }
+    t = (const TransformRecord *)scalingData;
+    for (size_t i = 0; i < scalingCount; i++)
+    {
+        scene->scalings.push_back(new Scaling(t[i].id, t[i].values[0], t[i].values[1], t[i].values[2]));
+    }
+    t = (const TransformRecord *)rotationData;
+    for (size_t i = 0; i < rotationCount; i++)
+    {
+        scene->rotations.push_back(new Rotation(t[i].id, t[i].values[0], t[i].values[1], t[i].values[2], t[i].values[3]));
+    }
+
+    const StepRecord *steps = (const StepRecord *)stepData;
+    for (size_t i = 0; i < meshCount; i++)
+    {
+        const MeshRecord &r = meshRecords[i];
+        Mesh *m = new Mesh();
+        m->meshId = r.meshId;
+        m->type = r.type;
+        for (uint32_t j = 0; j < r.stepCount; j++)
+        {
+            m->transformationTypes.push_back(steps[r.firstStep + j].type);
+            m->transformationIds.push_back(steps[r.firstStep + j].id);
+        }
+        m->numberOfTransformations = r.stepCount;
+        m->useExternal(Span<const uint32_t>(indices + r.firstIndex, r.indexCount),
+                       Span<const uint32_t>(vertexIndices + r.firstVertexIndex, r.vertexIndexCount));
+        m->bvh.useExternal(Span<const BvhNode>(bvhNodes + r.firstBvhNode, r.bvhNodeCount),
+                           Span<const uint32_t>(bvhOrder + r.firstBvhOrder, r.bvhOrderCount));
+        scene->meshes.push_back(m);
+    }
+
+    return true;
+}
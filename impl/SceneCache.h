@@ -0,0 +1,69 @@
+#ifndef __SCENECACHE_H__
+#define __SCENECACHE_H__
+
+#include <cstdint>
+#include <string>
+
+using namespace std;
+
+class Scene;
+
+#define SCENE_CACHE_VERSION 2
+#define SCENE_CACHE_ALIGNMENT 64
+
+// section types of a scene cache file
+#define SECTION_SETTINGS 1
+#define SECTION_CAMERAS 2
+#define SECTION_STRINGS 3
+#define SECTION_VERTEX_X 4
+#define SECTION_VERTEX_Y 5
+#define SECTION_VERTEX_Z 6
+#define SECTION_COLORS 7
+#define SECTION_TRANSLATIONS 8
+#define SECTION_SCALINGS 9
+#define SECTION_ROTATIONS 10
+#define SECTION_MESHES 11
+#define SECTION_MESH_STEPS 12
+#define SECTION_INDICES 13
+#define SECTION_VERTEX_INDICES 14
+#define SECTION_BVH_NODES 15
+#define SECTION_BVH_ORDER 16
+
+/*
+ * Identifies the XML file a cache was compiled from.
+ */
+class SceneSource
+{
+public:
+    uint64_t size;
+    int64_t mtime; // nanoseconds
+    uint64_t hash; // FNV-1a of the contents
+
+    bool read(const string &xmlPath, bool withHash);
+};
+
+/*
+ * Binary scene cache stored next to the XML as <xml>.cache. It is a header,
+ * a section table and SCENE_CACHE_ALIGNMENT aligned sections in native byte
+ * order. Vertex, index and BVH sections are used in place from the mapping;
+ * the small camera and transform sections are copied out.
+ */
+class SceneCache
+{
+public:
+    static string pathFor(const string &xmlPath);
+
+    /*
+     * Write scene, which was parsed from xmlPath, to pathFor(xmlPath).
+     */
+    static bool write(const Scene &scene, const string &xmlPath);
+
+    /*
+     * Fill scene from the cache of xmlPath if it exists and was compiled from
+     * the current XML. The scene keeps the mapping open for the arrays it uses.
+     * Returns false, leaving scene untouched, when the XML has to be parsed.
+     */
+    static bool load(Scene *scene, const string &xmlPath);
+};
+
+#endif
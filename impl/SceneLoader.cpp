@@ -0,0 +1,338 @@
+#include "SceneLoader.h"
+#include "Scene.h"
+#include "Helpers.h"
+#include "MappedFile.h"
+#include "NumberScanner.h"
+
+SceneLoader::SceneLoader(Scene *scene)
+{
+    this->scene = scene;
+    this->camera = NULL;
+    this->mesh = NULL;
+}
+
+bool SceneLoader::load(const string &path)
+{
+    MappedFile file;
+    if (!file.open(path))
+    {
+        error = "cannot open " + path;
+        return false;
+    }
+
+    XmlParser parser;
+    if (!parser.parse(file.data, file.size, *this))
+    {
+        error = path + ": " + parser.error;
+        return false;
+    }
+    if (!checkMeshes())
+    {
+        error = path + ": " + error;
+        return false;
+    }
+    return true;
+}
+
+/*
+ * The pipeline looks transformations and vertices up by id without checking
+ * them, so every reference of the meshes is checked here, once they are all read.
+ */
+bool SceneLoader::checkMeshes()
+{
+    for (const Mesh *m : scene->meshes)
+    {
+        for (size_t i = 0; i < m->transformationIds.size(); i++)
+        {
+            char type = m->transformationTypes[i];
+            int id = m->transformationIds[i];
+            if (type != 'r' && type != 't' && type != 's')
+            {
+                error = "mesh " + to_string(m->meshId) + " has unknown transformation type '" + type + "'";
+                return false;
+            }
+            size_t count = type == 'r' ? scene->rotations.size() : (type == 't' ? scene->translations.size() : scene->scalings.size());
+            if (id < 1 || (size_t)id > count)
+            {
+                error = "mesh " + to_string(m->meshId) + " uses missing transformation " + type + " " + to_string(id);
+                return false;
+            }
+        }
+        for (uint32_t index : m->indices)
+        {
+            if (index >= (uint32_t)scene->vertexData.size())
+            {
+                error = "mesh " + to_string(m->meshId) + " uses missing vertex " + to_string((int)index + 1);
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+const XmlText *SceneLoader::findAttribute(const vector<XmlAttribute> &attributes, const char *name)
+{
+    for (int i = 0; i < attributes.size(); i++)
+    {
+        if (attributes[i].name.equals(name))
+        {
+            return &attributes[i].value;
+        }
+    }
+    return NULL;
+}
+
+/*
+ * Read up to count whitespace separated numbers starting at p, which is moved
+ * past them. Returns how many were read.
+ */
+int SceneLoader::scanDoubles(const char *&p, const char *end, double *values, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (!NumberScanner::scanDouble(p, end, values[i]))
+        {
+            return i;
+        }
+    }
+    return count;
+}
+
+int SceneLoader::scanInts(const char *&p, const char *end, int *values, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        if (!NumberScanner::scanInt(p, end, values[i]))
+        {
+            return i;
+        }
+    }
+    return count;
+}
+
+int SceneLoader::scanDoubles(const XmlText &text, double *values, int count)
+{
+    const char *p = text.begin;
+    return scanDoubles(p, text.end, values, count);
+}
+
+int SceneLoader::scanInts(const XmlText &text, int *values, int count)
+{
+    const char *p = text.begin;
+    return scanInts(p, text.end, values, count);
+}
+
+bool SceneLoader::startElement(const XmlText &name, const vector<XmlAttribute> &attributes)
+{
+    current = name;
+
+    const XmlText *id = findAttribute(attributes, "id");
+    const XmlText *type = findAttribute(attributes, "type");
+    const XmlText *value = findAttribute(attributes, "value");
+
+    if (name.equals("Camera"))
+    {
+        camera = new Camera();
+        if (id != NULL)
+        {
+            scanInts(*id, &camera->cameraId, 1);
+        }
+        camera->projectionType = type != NULL && type->equals("orthographic") ? 0 : 1;
+    }
+    else if (name.equals("Vertex"))
+    {
+        double position[3] = {0, 0, 0};
+        double color[3] = {0, 0, 0};
+        const XmlText *positionText = findAttribute(attributes, "position");
+        const XmlText *colorText = findAttribute(attributes, "color");
+        if (positionText != NULL)
+        {
+            scanDoubles(*positionText, position, 3);
+        }
+        if (colorText != NULL)
+        {
+            scanDoubles(*colorText, color, 3);
+        }
+        scene->vertexData.addVertex(position[0], position[1], position[2], Color(color[0], color[1], color[2]));
+    }
+    else if (name.equals("Translation"))
+    {
+        Translation *translation = new Translation();
+        double v[3] = {0, 0, 0};
+        if (id != NULL)
+        {
+            scanInts(*id, &translation->translationId, 1);
+        }
+        if (value != NULL)
+        {
+            scanDoubles(*value, v, 3);
+        }
+        translation->tx = v[0];
+        translation->ty = v[1];
+        translation->tz = v[2];
+        scene->translations.push_back(translation);
+    }
+    else if (name.equals("Scaling"))
+    {
+        Scaling *scaling = new Scaling();
+        double v[3] = {0, 0, 0};
+        if (id != NULL)
+        {
+            scanInts(*id, &scaling->scalingId, 1);
+        }
+        if (value != NULL)
+        {
+            scanDoubles(*value, v, 3);
+        }
+        scaling->sx = v[0];
+        scaling->sy = v[1];
+        scaling->sz = v[2];
+        scene->scalings.push_back(scaling);
+    }
+    else if (name.equals("Rotation"))
+    {
+        Rotation *rotation = new Rotation();
+        double v[4] = {0, 0, 0, 0};
+        if (id != NULL)
+        {
+            scanInts(*id, &rotation->rotationId, 1);
+        }
+        if (value != NULL)
+        {
+            scanDoubles(*value, v, 4);
+        }
+        rotation->angle = v[0];
+        rotation->ux = v[1];
+        rotation->uy = v[2];
+        rotation->uz = v[3];
+        scene->rotations.push_back(rotation);
+    }
+    else if (name.equals("Mesh"))
+    {
+        mesh = new Mesh();
+        if (id != NULL)
+        {
+            scanInts(*id, &mesh->meshId, 1);
+        }
+        mesh->type = type != NULL && type->equals("wireframe") ? 0 : 1;
+    }
+
+    return true;
+}
+
+bool SceneLoader::endElement(const XmlText &name)
+{
+    current = XmlText();
+
+    if (name.equals("Camera") && camera != NULL)
+    {
+        camera->gaze = normalizeVec3(camera->gaze);
+        camera->u = crossProductVec3(camera->gaze, camera->v);
+        camera->u = normalizeVec3(camera->u);
+
+        camera->w = inverseVec3(camera->gaze);
+        camera->v = crossProductVec3(camera->u, camera->gaze);
+        camera->v = normalizeVec3(camera->v);
+
+        scene->cameras.push_back(camera);
+        camera = NULL;
+    }
+    else if (name.equals("Mesh") && mesh != NULL)
+    {
+        mesh->numberOfTransformations = mesh->transformationIds.size();
+        mesh->numberOfTriangles = mesh->indices.size() / 3;
+        mesh->collectVertexIndices();
+        scene->meshes.push_back(mesh);
+        mesh = NULL;
+    }
+    else if (name.equals("Meshes"))
+    {
+        // everything the renderer needs has been read
+        return false;
+    }
+
+    return true;
+}
+
+bool SceneLoader::text(const XmlText &content)
+{
+    if (current.begin == NULL)
+    {
+        return true;
+    }
+
+    if (current.equals("BackgroundColor"))
+    {
+        double c[3] = {0, 0, 0};
+        scanDoubles(content, c, 3);
+        scene->backgroundColor = Color(c[0], c[1], c[2]);
+    }
+    else if (current.equals("Culling"))
+    {
+        scene->cullingEnabled = content.trimmed().equals("enabled");
+    }
+    else if (camera != NULL)
+    {
+        double v[6] = {0, 0, 0, 0, 0, 0};
+        if (current.equals("Position"))
+        {
+            scanDoubles(content, v, 3);
+            camera->pos = Vec3(v[0], v[1], v[2], -1);
+        }
+        else if (current.equals("Gaze"))
+        {
+            scanDoubles(content, v, 3);
+            camera->gaze = Vec3(v[0], v[1], v[2], -1);
+        }
+        else if (current.equals("Up"))
+        {
+            scanDoubles(content, v, 3);
+            camera->v = Vec3(v[0], v[1], v[2], -1);
+        }
+        else if (current.equals("ImagePlane"))
+        {
+            int resolution[2] = {0, 0};
+            const char *p = content.begin;
+            scanDoubles(p, content.end, v, 6);
+            scanInts(p, content.end, resolution, 2);
+            camera->left = v[0];
+            camera->right = v[1];
+            camera->bottom = v[2];
+            camera->top = v[3];
+            camera->near = v[4];
+            camera->far = v[5];
+            camera->horRes = resolution[0];
+            camera->verRes = resolution[1];
+        }
+        else if (current.equals("OutputName"))
+        {
+            XmlText name = content.trimmed();
+            camera->outputFileName = string(name.begin, name.end);
+        }
+    }
+    else if (mesh != NULL)
+    {
+        if (current.equals("Transformation"))
+        {
+            XmlText step = content.trimmed();
+            int id = 0;
+            if (step.begin < step.end)
+            {
+                scanInts(XmlText(step.begin + 1, step.end), &id, 1);
+                mesh->transformationTypes.push_back(*step.begin);
+                mesh->transformationIds.push_back(id);
+            }
+        }
+        else if (current.equals("Faces"))
+        {
+            int v[3];
+            const char *p = content.begin;
+            while (scanInts(p, content.end, v, 3) == 3)
+            {
+                mesh->addTriangle(v[0], v[1], v[2]);
+            }
+        }
+    }
+
+    return true;
+}
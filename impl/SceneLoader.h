@@ -0,0 +1,48 @@
+#ifndef __SCENELOADER_H__
+#define __SCENELOADER_H__
+
+#include <string>
+#include <vector>
+#include "Camera.h"
+#include "Mesh.h"
+#include "XmlParser.h"
+
+using namespace std;
+
+class Scene;
+
+/*
+ * Fills a Scene from a scene XML file while it is being parsed. Values go
+ * straight into the scene arrays, and parsing stops once </Meshes> is seen.
+ */
+class SceneLoader : public XmlHandler
+{
+public:
+    SceneLoader(Scene *scene);
+
+    /*
+     * Returns false if the file cannot be read or is malformed, with a message in error.
+     */
+    bool load(const string &path);
+
+    string error;
+
+    bool startElement(const XmlText &name, const vector<XmlAttribute> &attributes);
+    bool endElement(const XmlText &name);
+    bool text(const XmlText &content);
+
+private:
+    Scene *scene;
+    Camera *camera; // being read, NULL outside <Camera>
+    Mesh *mesh;     // being read, NULL outside <Mesh>
+    XmlText current; // innermost open element, empty after its end tag
+
+    bool checkMeshes();
+    static const XmlText *findAttribute(const vector<XmlAttribute> &attributes, const char *name);
+    static int scanDoubles(const char *&p, const char *end, double *values, int count);
+    static int scanInts(const char *&p, const char *end, int *values, int count);
+    static int scanDoubles(const XmlText &text, double *values, int count);
+    static int scanInts(const XmlText &text, int *values, int count);
+};
+
+#endif
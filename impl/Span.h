@@ -0,0 +1,33 @@
+#ifndef __SPAN_H__
+#define __SPAN_H__
+
+#include <cstddef>
+#include <vector>
+
+using namespace std;
+
+/*
+ * Non-owning view of count contiguous elements, so stages can read scene
+ * arrays without copying them or caring which container owns them.
+ */
+template <typename T>
+class Span
+{
+public:
+    T *data;
+    size_t count;
+
+    Span() : data(NULL), count(0) {}
+    Span(T *data, size_t count) : data(data), count(count) {}
+    template <typename U>
+    Span(vector<U> &v) : data(v.data()), count(v.size()) {}
+    template <typename U>
+    Span(const vector<U> &v) : data(v.data()), count(v.size()) {}
+
+    size_t size() const { return count; }
+    T &operator[](size_t i) const { return data[i]; }
+    T *begin() const { return data; }
+    T *end() const { return data + count; }
+};
+
+#endif
@@ -0,0 +1,108 @@
+#include "ThreadPool.h"
+
+using namespace std;
+
+/*
+ * Start threadCount - 1 workers; the thread calling run() is the last one.
+ */
+ThreadPool::ThreadPool(int threadCount)
+{
+    this->job = NULL;
+    this->jobCount = 0;
+    this->nextJob = 0;
+    this->pendingWorkers = 0;
+    this->generation = 0;
+    this->stopping = false;
+
+    for (int i = 1; i < threadCount; i++)
+    {
+        workers.push_back(thread(&ThreadPool::workerLoop, this));
+    }
+}
+
+ThreadPool::~ThreadPool()
+{
+    {
+        unique_lock<mutex> guard(lock);
+        stopping = true;
+    }
+    wake.notify_all();
+
+    for (int i = 0; i < workers.size(); i++)
+    {
+        workers[i].join();
+    }
+}
+
+int ThreadPool::size()
+{
+    return workers.size() + 1;
+}
+
+/*
+ * Call job(0) ... job(jobCount - 1) spread over the pool and wait for all of them.
+ * Jobs are handed out in increasing order, but may finish in any order.
+ */
+void ThreadPool::run(int jobCount, const function<void(int)> &job)
+{
+    if (workers.empty())
+    {
+        for (int i = 0; i < jobCount; i++)
+        {
+            job(i);
+        }
+        return;
+    }
+
+    {
+        unique_lock<mutex> guard(lock);
+        this->job = &job;
+        this->jobCount = jobCount;
+        this->nextJob = 0;
+        this->pendingWorkers = workers.size();
+        this->generation++;
+    }
+    wake.notify_all();
+
+    work();
+
+    unique_lock<mutex> guard(lock);
+    done.wait(guard, [this] { return pendingWorkers == 0; });
+    this->job = NULL;
+}
+
+void ThreadPool::workerLoop()
+{
+    int seenGeneration = 0;
+
+    while (true)
+    {
+        {
+            unique_lock<mutex> guard(lock);
+            wake.wait(guard, [&] { return stopping || generation != seenGeneration; });
+
+            if (stopping)
+            {
+                return;
+            }
+            seenGeneration = generation;
+        }
+
+        work();
+
+        unique_lock<mutex> guard(lock);
+        if (--pendingWorkers == 0)
+        {
+            done.notify_all();
+        }
+    }
+}
+
+void ThreadPool::work()
+{
+    int i;
+    while ((i = nextJob++) < jobCount)
+    {
+        (*job)(i);
+    }
+}
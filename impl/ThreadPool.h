@@ -0,0 +1,39 @@
+#ifndef __THREADPOOL_H__
+#define __THREADPOOL_H__
+
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+class ThreadPool
+{
+public:
+    ThreadPool(int threadCount);
+    ~ThreadPool();
+
+    int size();
+    void run(int jobCount, const function<void(int)> &job);
+
+private:
+    vector<thread> workers;
+    mutex lock;
+    condition_variable wake;
+    condition_variable done;
+
+    const function<void(int)> *job;
+    int jobCount;
+    atomic<int> nextJob;
+    int pendingWorkers;
+    int generation;
+    bool stopping;
+
+    void workerLoop();
+    void work();
+};
+
+#endif
@@ -0,0 +1,48 @@
+#include "TransformCache.h"
+#include "Helpers.h"
+
+TransformCache::TransformCache()
+{
+    clear();
+}
+
+void TransformCache::clear()
+{
+    nodes.clear();
+    nodes.push_back(TransformNode());
+    nodes[0].matrix = getIdentityMatrix();
+}
+
+/*
+ * Node reached from node by the step (type, id), -1 if it is not cached yet.
+ */
+int TransformCache::getChild(int node, char type, int id)
+{
+    map<long long, int>::iterator it = nodes[node].children.find(stepKey(type, id));
+    return it == nodes[node].children.end() ? -1 : it->second;
+}
+
+/*
+ * Cache the step (type, id) below node, where step is the step's own matrix.
+ * The new node holds step * the matrix of node, since later steps apply last.
+ */
+int TransformCache::addChild(int node, char type, int id, const Matrix4 &step)
+{
+    TransformNode child;
+    child.matrix = multiplyMatrixWithMatrix(step, nodes[node].matrix);
+
+    int index = nodes.size();
+    nodes.push_back(child);
+    nodes[node].children[stepKey(type, id)] = index;
+    return index;
+}
+
+const Matrix4 &TransformCache::getMatrix(int node) const
+{
+    return nodes[node].matrix;
+}
+
+long long TransformCache::stepKey(char type, int id)
+{
+    return ((long long)(unsigned char)type << 32) | (unsigned int)id;
+}
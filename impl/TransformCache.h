@@ -0,0 +1,37 @@
+#ifndef __TRANSFORMCACHE_H__
+#define __TRANSFORMCACHE_H__
+
+#include <map>
+#include <vector>
+#include "Matrix4.h"
+
+using namespace std;
+
+class TransformNode
+{
+public:
+    Matrix4 matrix;              // product of every step from the root to here
+    map<long long, int> children; // keyed by TransformCache::stepKey
+};
+
+/*
+ * Trie of composed model transforms. Each path from the root is a sequence of
+ * (type, id) steps, so meshes with equal or prefix-sharing transformation
+ * lists share nodes and every product is computed once per scene.
+ */
+class TransformCache
+{
+public:
+    vector<TransformNode> nodes; // nodes[0] is the root, the identity
+
+    TransformCache();
+
+    void clear();
+    int getChild(int node, char type, int id);
+    int addChild(int node, char type, int id, const Matrix4 &step);
+    const Matrix4 &getMatrix(int node) const;
+
+    static long long stepKey(char type, int id);
+};
+
+#endif
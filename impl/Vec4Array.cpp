@@ -0,0 +1,37 @@
+#include "Vec4Array.h"
+
+Vec4Array::Vec4Array() {}
+
+void Vec4Array::resize(int count)
+{
+    x.resize(count);
+    y.resize(count);
+    z.resize(count);
+    t.resize(count);
+}
+
+int Vec4Array::size() const
+{
+    return x.size();
+}
+
+Vec4 Vec4Array::get(int i, int colorId) const
+{
+    return Vec4(x[i], y[i], z[i], t[i], colorId);
+}
+
+void Vec4Array::set(int i, const Vec4 &v)
+{
+    x[i] = v.x;
+    y[i] = v.y;
+    z[i] = v.z;
+    t[i] = v.t;
+}
+
+void Vec4Array::getPointers(double *p[4], int first)
+{
+    p[0] = x.data() + first;
+    p[1] = y.data() + first;
+    p[2] = z.data() + first;
+    p[3] = t.data() + first;
+}
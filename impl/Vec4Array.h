@@ -0,0 +1,32 @@
+#ifndef __VEC4ARRAY_H__
+#define __VEC4ARRAY_H__
+
+#include <vector>
+#include "Vec4.h"
+
+using namespace std;
+
+/*
+ * Homogeneous points stored as structure of arrays, one array per component,
+ * so batched transforms can load several points per instruction.
+ */
+class Vec4Array
+{
+public:
+    vector<double> x, y, z, t;
+
+    Vec4Array();
+
+    void resize(int count);
+    int size() const;
+
+    Vec4 get(int i, int colorId) const;
+    void set(int i, const Vec4 &v);
+
+    /*
+     * Fill p with pointers to the four components, starting at point first.
+     */
+    void getPointers(double *p[4], int first);
+};
+
+#endif
@@ -0,0 +1,38 @@
+#include "VertexBuffer.h"
+
+VertexBuffer::VertexBuffer() {}
+
+void VertexBuffer::addVertex(double x, double y, double z, const Color &color)
+{
+    storedX.push_back(x);
+    storedY.push_back(y);
+    storedZ.push_back(z);
+    storedColors.push_back(color);
+
+    // growing may move the storage, so the views are refreshed every time
+    this->x = Span<const double>(storedX);
+    this->y = Span<const double>(storedY);
+    this->z = Span<const double>(storedZ);
+    this->colors = Span<const Color>(storedColors);
+}
+
+/*
+ * View arrays owned elsewhere; they must outlive the buffer.
+ */
+void VertexBuffer::useExternal(Span<const double> x, Span<const double> y, Span<const double> z, Span<const Color> colors)
+{
+    storedX.clear();
+    storedY.clear();
+    storedZ.clear();
+    storedColors.clear();
+
+    this->x = x;
+    this->y = y;
+    this->z = z;
+    this->colors = colors;
+}
+
+int VertexBuffer::size() const
+{
+    return x.size();
+}
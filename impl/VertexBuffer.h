@@ -0,0 +1,36 @@
+#ifndef __VERTEXBUFFER_H__
+#define __VERTEXBUFFER_H__
+
+#include <vector>
+#include "Color.h"
+#include "Span.h"
+
+using namespace std;
+
+/*
+ * Scene vertices as structure of arrays: one contiguous array per position
+ * component and one for colors. Vertex id n is stored at index n-1.
+ * The arrays are views, either of storage filled by addVertex or of
+ * memory owned by someone else, such as a mapped scene cache.
+ */
+class VertexBuffer
+{
+public:
+    Span<const double> x, y, z;
+    Span<const Color> colors;
+
+    VertexBuffer();
+
+    void addVertex(double x, double y, double z, const Color &color);
+    void useExternal(Span<const double> x, Span<const double> y, Span<const double> z, Span<const Color> colors);
+    int size() const;
+
+private:
+    vector<double> storedX, storedY, storedZ;
+    vector<Color> storedColors;
+
+    VertexBuffer(const VertexBuffer &other);
+    VertexBuffer &operator=(const VertexBuffer &other);
+};
+
+#endif
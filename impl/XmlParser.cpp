@@ -0,0 +1,241 @@
+#include "XmlParser.h"
+#include <algorithm>
+
+XmlText::XmlText()
+{
+    this->begin = NULL;
+    this->end = NULL;
+}
+
+XmlText::XmlText(const char *begin, const char *end)
+{
+    this->begin = begin;
+    this->end = end;
+}
+
+bool XmlText::equals(const char *s) const
+{
+    size_t length = strlen(s);
+    return (size_t)(end - begin) == length && memcmp(begin, s, length) == 0;
+}
+
+static bool isSpace(char c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r';
+}
+
+XmlText XmlText::trimmed() const
+{
+    const char *b = begin, *e = end;
+    while (b < e && isSpace(*b))
+    {
+        b++;
+    }
+    while (e > b && isSpace(e[-1]))
+    {
+        e--;
+    }
+    return XmlText(b, e);
+}
+
+static bool isNameEnd(char c)
+{
+    return isSpace(c) || c == '>' || c == '/' || c == '=';
+}
+
+static bool startsWith(const char *p, const char *end, const char *s)
+{
+    size_t length = strlen(s);
+    return (size_t)(end - p) >= length && memcmp(p, s, length) == 0;
+}
+
+/*
+ * Position of the first occurrence of s in [p, end), or NULL.
+ */
+static const char *findString(const char *p, const char *end, const char *s)
+{
+    size_t length = strlen(s);
+    const char *found = search(p, end, s, s + length);
+    return found == end ? NULL : found;
+}
+
+XmlParser::XmlParser()
+{
+    this->error = NULL;
+}
+
+bool XmlParser::parse(const char *data, size_t size, XmlHandler &handler)
+{
+    const char *p = data, *end = data + size;
+    error = NULL;
+
+    while (p < end)
+    {
+        // character data up to the next markup
+        if (*p != '<')
+        {
+            const char *next = (const char *)memchr(p, '<', end - p);
+            if (next == NULL)
+            {
+                // trailing content after the root element
+                break;
+            }
+            if (!handler.text(XmlText(p, next)))
+            {
+                return true;
+            }
+            p = next;
+            continue;
+        }
+
+        if (startsWith(p, end, "<!--"))
+        {
+            const char *close = findString(p + 4, end, "-->");
+            if (close == NULL)
+            {
+                error = "unterminated comment";
+                return false;
+            }
+            p = close + 3;
+        }
+        else if (startsWith(p, end, "<![CDATA["))
+        {
+            const char *close = findString(p + 9, end, "]]>");
+            if (close == NULL)
+            {
+                error = "unterminated CDATA section";
+                return false;
+            }
+            if (!handler.text(XmlText(p + 9, close)))
+            {
+                return true;
+            }
+            p = close + 3;
+        }
+        else if (startsWith(p, end, "<?") || startsWith(p, end, "<!"))
+        {
+            // declarations and processing instructions carry nothing a scene needs
+            const char *close = (const char *)memchr(p, '>', end - p);
+            if (close == NULL)
+            {
+                error = "unterminated declaration";
+                return false;
+            }
+            p = close + 1;
+        }
+        else if (startsWith(p, end, "</"))
+        {
+            const char *name = p + 2;
+            const char *nameEnd = name;
+            while (nameEnd < end && !isNameEnd(*nameEnd))
+            {
+                nameEnd++;
+            }
+            const char *close = (const char *)memchr(nameEnd, '>', end - nameEnd);
+            if (close == NULL || nameEnd == name)
+            {
+                error = "malformed end tag";
+                return false;
+            }
+            if (!handler.endElement(XmlText(name, nameEnd)))
+            {
+                return true;
+            }
+            p = close + 1;
+        }
+        else
+        {
+            const char *name = p + 1;
+            const char *q = name;
+            while (q < end && !isNameEnd(*q))
+            {
+                q++;
+            }
+            XmlText elementName(name, q);
+            if (q == name)
+            {
+                error = "malformed start tag";
+                return false;
+            }
+
+            attributes.clear();
+            bool selfClosing = false;
+            while (true)
+            {
+                while (q < end && isSpace(*q))
+                {
+                    q++;
+                }
+                if (q >= end)
+                {
+                    error = "unterminated start tag";
+                    return false;
+                }
+                if (*q == '>')
+                {
+                    q++;
+                    break;
+                }
+                if (*q == '/')
+                {
+                    if (q + 1 >= end || q[1] != '>')
+                    {
+                        error = "malformed start tag";
+                        return false;
+                    }
+                    selfClosing = true;
+                    q += 2;
+                    break;
+                }
+
+                XmlAttribute attribute;
+                attribute.name.begin = q;
+                while (q < end && !isNameEnd(*q))
+                {
+                    q++;
+                }
+                attribute.name.end = q;
+                while (q < end && isSpace(*q))
+                {
+                    q++;
+                }
+                if (q >= end || *q != '=' || attribute.name.begin == attribute.name.end)
+                {
+                    error = "malformed attribute";
+                    return false;
+                }
+                q++;
+                while (q < end && isSpace(*q))
+                {
+                    q++;
+                }
+                if (q >= end || (*q != '"' && *q != '\''))
+                {
+                    error = "unquoted attribute value";
+                    return false;
+                }
+                const char *close = (const char *)memchr(q + 1, *q, end - q - 1);
+                if (close == NULL)
+                {
+                    error = "unterminated attribute value";
+                    return false;
+                }
+                attribute.value = XmlText(q + 1, close);
+                attributes.push_back(attribute);
+                q = close + 1;
+            }
+
+            if (!handler.startElement(elementName, attributes))
+            {
+                return true;
+            }
+            if (selfClosing && !handler.endElement(elementName))
+            {
+                return true;
+            }
+            p = q;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,71 @@
+#ifndef __XMLPARSER_H__
+#define __XMLPARSER_H__
+
+#include <cstring>
+#include <vector>
+
+using namespace std;
+
+/*
+ * A [begin, end) range of the input buffer. Nothing is copied or terminated,
+ * so callers compare and scan within the range.
+ */
+class XmlText
+{
+public:
+    const char *begin, *end;
+
+    XmlText();
+    XmlText(const char *begin, const char *end);
+
+    bool equals(const char *s) const;
+    XmlText trimmed() const;
+};
+
+class XmlAttribute
+{
+public:
+    XmlText name;
+    XmlText value; // raw, entities are not expanded
+};
+
+/*
+ * Receives parse events in document order. Returning false from any callback
+ * stops the parse early.
+ */
+class XmlHandler
+{
+public:
+    virtual ~XmlHandler() {}
+
+    virtual bool startElement(const XmlText &name, const vector<XmlAttribute> &attributes) = 0;
+    virtual bool endElement(const XmlText &name) = 0;
+    virtual bool text(const XmlText &content) = 0;
+};
+
+/*
+ * Streaming (SAX style) parser for the subset of XML used by scene files:
+ * elements, attributes, character data, comments, CDATA and declarations,
+ * which are skipped. It tokenizes the buffer in place and keeps no tree.
+ * Every text range passed to the handler is followed by '<' in the buffer
+ * and every attribute value by its quote, so numbers can be scanned without
+ * copying them out first.
+ */
+class XmlParser
+{
+public:
+    XmlParser();
+
+    /*
+     * Parse [data, data + size). Returns false on malformed input, with a
+     * description in error.
+     */
+    bool parse(const char *data, size_t size, XmlHandler &handler);
+
+    const char *error;
+
+private:
+    vector<XmlAttribute> attributes; // reused between elements
+};
+
+#endif